@@ -0,0 +1,118 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Per-keystroke cost of the fuzzy matcher in src/fuzzy.c, filtering plus
+// ranking. The query is typed one character at a time; "full" rescans every
+// candidate while "incremental" only rescores the previous matches, as
+// handle_search did before the executor; "pool" is a full scan through the
+// executor in src/match.c, chunked over every CPU and keeping the top
+// MATCH_TOP_K ranked. As in handle_search, the candidates' folded forms are
+// computed up front.
+// Usage: fuzzy_bench [candidates] [query]
+
+#include "../src/fold.h"
+#include "../src/fuzzy.h"
+#include "../src/match.h"
+#include "../src/pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  static const char *const words[] = {"report", "build",  "src",   "notes",
+                                      "final",  "backup", "draft", "q3",
+                                      "image",  "trace",  "log",   "data"};
+  static const char *const exts[] = {".csv", ".txt", ".tar.gz", ".c", ".log"};
+  const int n_words = sizeof(words) / sizeof(words[0]);
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  const char *query = argc > 2 ? argv[2] : "report";
+  char **names = malloc(n * sizeof(*names));
+  char **folded = malloc(n * sizeof(*folded));
+  fuzzy_result *results = malloc(n * sizeof(*results));
+  fuzzy_result *ranked = malloc(n * sizeof(*ranked));
+  match_exec ex;
+  if (!names || !folded || !results || !ranked || !match_exec_init(&ex, n))
+    return EXIT_FAILURE;
+  srand(42);
+  for (int i = 0; i < n; i++) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%d_%s_%s-%s%05d%s", 2000 + rand() % 30,
+             words[rand() % n_words], words[rand() % n_words],
+             words[rand() % n_words], rand() % 100000, exts[rand() % 5]);
+    names[i] = strdup(buf);
+    folded[i] = fold_dup(buf);
+  }
+
+  printf("%d candidates, query \"%s\", %d pool workers\n", n, query,
+         pool_workers());
+  printf("%-10s %8s %12s %12s %12s\n", "query", "matches", "full ms",
+         "incr ms", "pool ms");
+  char typed[FUZZY_MAX_QUERY] = {0};
+  int count = 0;
+  for (int len = 1; query[len - 1] && len < FUZZY_MAX_QUERY; len++) {
+    fuzzy_pattern pat;
+    memcpy(typed, query, len);
+    typed[len] = '\0';
+    fuzzy_compile(&pat, typed);
+
+    double t0 = now();
+    int full = fuzzy_filter(&pat, names, folded, n, NULL, 0, results);
+    memcpy(ranked, results, full * sizeof(*ranked));
+    fuzzy_sort(ranked, full);
+    double t1 = now();
+    // Rebuild the previous keystroke's matches, then time the refinement
+    if (len > 1) {
+      fuzzy_pattern prev;
+      typed[len - 1] = '\0';
+      fuzzy_compile(&prev, typed);
+      count = fuzzy_filter(&prev, names, folded, n, NULL, 0, results);
+      typed[len - 1] = query[len - 1];
+    }
+    double t2 = now();
+    if (len > 1) {
+      count = fuzzy_filter(&pat, names, folded, n, results, count, results);
+      memcpy(ranked, results, count * sizeof(*ranked));
+      fuzzy_sort(ranked, count);
+    }
+    double t3 = now();
+    match_fuzzy(&ex, names, folded, n, &pat, false);
+    match_wait(&ex);
+    double t4 = now();
+    printf("%-10s %8d %12.2f %12.2f %12.2f\n", typed, full, (t1 - t0) * 1e3,
+           len > 1 ? (t3 - t2) * 1e3 : (t1 - t0) * 1e3, (t4 - t3) * 1e3);
+    if (len > 1 && count != full)
+      fprintf(stderr, "mismatch: %d incremental vs %d full\n", count, full);
+    if (ex.n_set != full)
+      fprintf(stderr, "mismatch: %d pooled vs %d full\n", ex.n_set, full);
+    for (int i = 0; i < ex.n_top; i++)
+      if (ex.top[i].index != ranked[i].index) {
+        fprintf(stderr, "mismatch: pooled rank %d\n", i);
+        break;
+      }
+  }
+  match_exec_free(&ex);
+  pool_shutdown();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Newline counting throughput of the kernels in src/lines.c against a
+// memchr loop. "memchr" counts by calling memchr once per line, "count" is
+// lines_count on one thread, and "index" is lines_index over the worker
+// pool, keeping a mark every 1024 lines as the built-in viewer does. The
+// text is generated in memory, with lines of 0 to 160 bytes, or read from
+// FILE. Each figure is the best of five runs.
+// Usage: lines_bench [MiB] [FILE]
+
+#include "../src/lines.h"
+#include "../src/pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RUNS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t count_memchr(const char *s, size_t len) {
+  size_t n = 0;
+  const char *end = s + len;
+  while ((s = memchr(s, '\n', end - s))) {
+    s++;
+    n++;
+  }
+  return n;
+}
+
+static char *generate(size_t len) {
+  char *buf = malloc(len);
+  if (!buf)
+    return NULL;
+  srand(42);
+  for (size_t i = 0; i < len;) {
+    size_t line = (size_t)(rand() % 161);
+    for (size_t k = 0; k < line && i < len; k++)
+      buf[i++] = (char)(' ' + rand() % 95);
+    if (i < len)
+      buf[i++] = '\n';
+  }
+  return buf;
+}
+
+static char *load(const char *path, size_t *len) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+    return NULL;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *buf = size > 0 ? malloc((size_t)size) : NULL;
+  if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(fp);
+  *len = buf ? (size_t)size : 0;
+  return buf;
+}
+
+int main(int argc, char **argv) {
+  size_t len = (size_t)(argc > 1 ? atol(argv[1]) : 1024) << 20;
+  char *buf = argc > 2 ? load(argv[2], &len) : generate(len);
+  if (!buf) {
+    fprintf(stderr, "Cannot prepare %s\n", argc > 2 ? argv[2] : "the text");
+    return EXIT_FAILURE;
+  }
+  const char *names[] = {"memchr", "count", "index"};
+  double best[3] = {1e30, 1e30, 1e30};
+  size_t lines[3] = {0}, n_marks = 0, cap_marks = 0;
+  line_mark *marks = NULL;
+  for (int run = 0; run < RUNS; run++)
+    for (int k = 0; k < 3; k++) {
+      double t0 = now();
+      if (k == 0)
+        lines[k] = count_memchr(buf, len);
+      else if (k == 1)
+        lines[k] = lines_count(buf, len);
+      else {
+        n_marks = 0;
+        lines[k] = lines_index(buf, 0, len, 0, 1024, &marks, &n_marks,
+                               &cap_marks);
+      }
+      double t = now() - t0;
+      if (t < best[k])
+        best[k] = t;
+    }
+  printf("%zu MiB, %zu lines, %d pool workers\n", len >> 20, lines[0],
+         pool_workers());
+  printf("%-8s %10s %10s\n", "kernel", "ms", "GB/s");
+  for (int k = 0; k < 3; k++) {
+    printf("%-8s %10.2f %10.2f\n", names[k], best[k] * 1e3,
+           len / best[k] / 1e9);
+    if (lines[k] != lines[0])
+      fprintf(stderr, "mismatch: %zu lines by %s\n", lines[k], names[k]);
+  }
+  // Every mark must start the line it claims to
+  for (size_t i = 0; i < n_marks; i++) {
+    line_mark from = i ? marks[i - 1] : (line_mark){0, 0};
+    size_t left = marks[i].line - from.line;
+    size_t at =
+        from.offset + lines_skip(buf + from.offset, len - from.offset, &left);
+    if (left || at != marks[i].offset) {
+      fprintf(stderr, "mismatch: mark %zu\n", i);
+      break;
+    }
+  }
+  free(marks);
+  free(buf);
+  pool_shutdown();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Memory and throughput comparison between the radix tree in src/trie.c and
+// the original layout with one child pointer per ASCII symbol.
+// Usage: trie_bench [entries] [queries]
+
+#include "../src/trie.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LEGACY_ALPHABET_SIZE 128
+
+typedef struct legacy_node {
+  struct legacy_node *children[LEGACY_ALPHABET_SIZE];
+  bool is_end_of_word;
+  int index;
+} legacy_node;
+
+static legacy_node *legacy_create(void) {
+  legacy_node *node = calloc(1, sizeof(legacy_node));
+  if (node)
+    node->index = -1;
+  return node;
+}
+
+static void legacy_insert(legacy_node *root, const char *word, int index) {
+  legacy_node *cur = root;
+  for (int i = 0; word[i]; i++) {
+    int idx = (int)word[i];
+    if (idx < 0 || idx >= LEGACY_ALPHABET_SIZE)
+      continue;
+    if (!cur->children[idx] && !(cur->children[idx] = legacy_create()))
+      return;
+    cur = cur->children[idx];
+  }
+  cur->is_end_of_word = true;
+  cur->index = index;
+}
+
+static legacy_node *legacy_search(legacy_node *root, const char *prefix) {
+  legacy_node *cur = root;
+  for (int i = 0; prefix[i]; i++) {
+    int idx = (int)prefix[i];
+    if (idx < 0 || idx >= LEGACY_ALPHABET_SIZE || !cur->children[idx])
+      return NULL;
+    cur = cur->children[idx];
+  }
+  return cur;
+}
+
+static void legacy_collect(legacy_node *node, int *indices, int *count,
+                           int max_count) {
+  if (!node || *count >= max_count)
+    return;
+  if (node->is_end_of_word)
+    indices[(*count)++] = node->index;
+  for (int i = 0; i < LEGACY_ALPHABET_SIZE; i++)
+    if (node->children[i])
+      legacy_collect(node->children[i], indices, count, max_count);
+}
+
+static void legacy_free(legacy_node *node) {
+  if (!node)
+    return;
+  for (int i = 0; i < LEGACY_ALPHABET_SIZE; i++)
+    legacy_free(node->children[i]);
+  free(node);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t heap_in_use(void) { return mallinfo2().uordblks; }
+
+static void report(const char *name, size_t bytes, double build, double query,
+                   int n_queries, long hits) {
+  printf("%-8s %10.1f MiB %10.1f ms build %10.2f us/query (%ld hits)\n", name,
+         bytes / (1024.0 * 1024.0), build * 1e3, query * 1e6 / n_queries,
+         hits);
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 20000;
+  int n_queries = argc > 2 ? atoi(argv[2]) : 1000;
+  char **names = malloc(n * sizeof(*names));
+  char **queries = malloc(n_queries * sizeof(*queries));
+  if (!names || !queries)
+    return EXIT_FAILURE;
+  srand(42);
+  for (int i = 0; i < n; i++) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%s-%05d-nightly-build-artifact-%08x-linux-x86_64-%s.tar.gz",
+             (i % 3) ? "fex" : "report", rand() % 100000, (unsigned)rand(),
+             (i % 2) ? "release" : "debug");
+    names[i] = strdup(buf);
+  }
+  for (int i = 0; i < n_queries; i++) {
+    const char *src = names[rand() % n];
+    int len = 1 + rand() % 12;
+    queries[i] = strndup(src, len);
+  }
+  int *indices = malloc(BUFSIZE * sizeof(*indices));
+  long hits;
+
+  size_t base = heap_in_use();
+  double t0 = now();
+  legacy_node *legacy = legacy_create();
+  for (int i = 0; i < n; i++)
+    legacy_insert(legacy, names[i], i);
+  double t1 = now();
+  size_t legacy_bytes = heap_in_use() - base;
+  hits = 0;
+  for (int i = 0; i < n_queries; i++) {
+    int count = 0;
+    legacy_collect(legacy_search(legacy, queries[i]), indices, &count,
+                   BUFSIZE);
+    hits += count;
+  }
+  double t2 = now();
+  report("legacy", legacy_bytes, t1 - t0, t2 - t1, n_queries, hits);
+  legacy_free(legacy);
+
+  base = heap_in_use();
+  t0 = now();
+  trie_node *radix = create_trie_node();
+  for (int i = 0; i < n; i++)
+    insert_trie(radix, names[i], i);
+  t1 = now();
+  size_t radix_bytes = heap_in_use() - base;
+  hits = 0;
+  for (int i = 0; i < n_queries; i++) {
+    int count = 0;
+    collect_trie_indices(search_trie_prefix(radix, queries[i]), indices,
+                         &count, BUFSIZE);
+    hits += count;
+  }
+  t2 = now();
+  report("radix", radix_bytes, t1 - t0, t2 - t1, n_queries, hits);
+  free_trie(radix);
+  return EXIT_SUCCESS;
+}
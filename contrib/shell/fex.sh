@@ -1,12 +1,14 @@
 # /etc/profile.d/fex.sh
 # fex shell integration (bash-compatible)
 
+# fex_exec draws on the terminal and hands the final directory back on
+# descriptor 3, a pipe read by the command substitution: no temporary file
+# and no external command.
 fex() {
-  /usr/bin/fex_exec "${1:-.}" || return
-  if [ -f "$HOME/.fexlastdir" ]; then
-    target="$(cat "$HOME/.fexlastdir")"
-    if [ -n "$target" ] && [ -d "$target" ]; then
-      cd "$target" || return
-    fi
+  local target
+  target="$(FEX_HANDOFF_FD=3 /usr/bin/fex_exec "${1:-.}" 3>&1 1>/dev/tty)" ||
+    return
+  if [ -n "$target" ] && [ -d "$target" ]; then
+    cd "$target" || return
   fi
 }
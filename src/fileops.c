@@ -0,0 +1,523 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#define _GNU_SOURCE // copy_file_range, renameat2
+#include "fileops.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+// Bytes moved between progress updates and checks for a cancel
+#define STEP (8 << 20)
+#define BUFFER (1 << 20)
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_t thread;
+  enum fileops_state state;
+  bool joinable, move, cancel;
+  // Set while the worker may still touch files; read from signal handlers
+  bool active;
+  char **paths;
+  int n_paths;
+  char dest[PATH_MAX];
+  // Progress, under the lock
+  int done, failed;
+  long long bytes, total;
+  char current[256], error[256];
+} op = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static bool cancelled(void) {
+  return __atomic_load_n(&op.cancel, __ATOMIC_RELAXED);
+}
+
+static void add_bytes(long long n) {
+  pthread_mutex_lock(&op.lock);
+  op.bytes += n;
+  pthread_mutex_unlock(&op.lock);
+}
+
+static void set_current(const char *name) {
+  pthread_mutex_lock(&op.lock);
+  snprintf(op.current, sizeof(op.current), "%s", name);
+  pthread_mutex_unlock(&op.lock);
+}
+
+// Keeps the first error for the status line and counts the entry as failed
+static void fail(const char *name, int err) {
+  pthread_mutex_lock(&op.lock);
+  if (!op.failed++)
+    snprintf(op.error, sizeof(op.error), "%s: %s", name, strerror(err));
+  pthread_mutex_unlock(&op.lock);
+}
+
+static long long tree_size(int dirfd, const char *name) {
+  struct stat st;
+  if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    return 0;
+  if (!S_ISDIR(st.st_mode))
+    return S_ISREG(st.st_mode) ? (long long)st.st_size : 0;
+  int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+  if (!dir) {
+    if (fd >= 0)
+      close(fd);
+    return 0;
+  }
+  long long size = 0;
+  struct dirent *e;
+  while ((e = readdir(dir)) && !cancelled())
+    if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+      size += tree_size(fd, e->d_name);
+  closedir(dir);
+  return size;
+}
+
+typedef ssize_t (*copy_fn)(int, int, size_t, char *);
+
+#ifdef __linux__
+static ssize_t by_range(int in, int out, size_t len, char *buf) {
+  (void)buf;
+  return copy_file_range(in, NULL, out, NULL, len, 0);
+}
+
+static ssize_t by_sendfile(int in, int out, size_t len, char *buf) {
+  (void)buf;
+  return sendfile(out, in, NULL, len);
+}
+#endif
+
+static ssize_t by_buffer(int in, int out, size_t len, char *buf) {
+  ssize_t n = read(in, buf, len < BUFFER ? len : BUFFER);
+  for (ssize_t put = 0, w; put < n; put += w)
+    if ((w = write(out, buf + put, n - put)) < 0)
+      return -1;
+  return n;
+}
+
+// Copies in from its offset to the end with fn, STEP at a time. Returns 1,
+// having copied nothing, when fn does not work for these files.
+static int pump(copy_fn fn, int in, int out, char *buf) {
+  bool any = false;
+  for (;;) {
+    if (cancelled()) {
+      errno = ECANCELED;
+      return -1;
+    }
+    ssize_t n = fn(in, out, STEP, buf);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && !any &&
+        (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+         errno == EOPNOTSUPP || errno == EBADF))
+      return 1;
+    if (n <= 0)
+      return (int)n;
+    any = true;
+    add_bytes(n);
+  }
+}
+
+static int copy_data(int in, int out, long long size, char *buf) {
+#ifdef FICLONE
+  // A reflink shares the blocks and copies nothing, on Btrfs, XFS and the
+  // like
+  if (ioctl(out, FICLONE, in) == 0) {
+    add_bytes(size);
+    return 0;
+  }
+#else
+  (void)size;
+#endif
+  int rc = 1;
+#ifdef __linux__
+  // Both stay in the kernel; copy_file_range can even copy on the server
+  // for NFS and SMB
+  rc = pump(by_range, in, out, buf);
+  if (rc == 1)
+    rc = pump(by_sendfile, in, out, buf);
+#endif
+  if (rc == 1)
+    rc = pump(by_buffer, in, out, buf);
+  return rc;
+}
+
+static int copy_file(int sdir, const char *name, int ddir, const char *dname,
+                     const struct stat *st, char *buf) {
+  int in = openat(sdir, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+  if (in < 0)
+    return -1;
+  int out = openat(ddir, dname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                   st->st_mode & 07777);
+  if (out < 0) {
+    close(in);
+    return -1;
+  }
+  set_current(dname);
+  int rc = copy_data(in, out, st->st_size, buf);
+  int err = errno;
+  close(in);
+  if (close(out) != 0 && rc == 0) {
+    rc = -1;
+    err = errno;
+  }
+  // No half-written file is left behind, cancelled or not
+  if (rc != 0)
+    unlinkat(ddir, dname, 0);
+  errno = err;
+  return rc;
+}
+
+// The next entry other than . and ..; NULL at the end, with errno 0, or on
+// an error, with errno set
+static struct dirent *next_entry(DIR *dir) {
+  struct dirent *e;
+  do
+    errno = 0;
+  while ((e = readdir(dir)) &&
+         (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0));
+  return e;
+}
+
+static int remove_tree(int, const char *);
+
+static int copy_tree(int sdir, const char *name, int ddir, const char *dname,
+                     char *buf) {
+  struct stat st;
+  if (fstatat(sdir, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    return -1;
+  if (S_ISREG(st.st_mode))
+    return copy_file(sdir, name, ddir, dname, &st, buf);
+  if (S_ISLNK(st.st_mode)) {
+    char target[PATH_MAX];
+    ssize_t n = readlinkat(sdir, name, target, sizeof(target) - 1);
+    if (n < 0)
+      return -1;
+    target[n] = '\0';
+    return symlinkat(target, ddir, dname);
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  // Written into while it is owner-only, then given the source's mode
+  if (mkdirat(ddir, dname, 0700) != 0)
+    return -1;
+  int s = openat(sdir, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  int d = openat(ddir, dname, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  DIR *dir = s >= 0 ? fdopendir(s) : NULL;
+  int rc = dir && d >= 0 ? 0 : -1;
+  struct dirent *e;
+  // A directory that could not be read to its end is not a copy of it
+  while (rc == 0 && ((e = next_entry(dir)) || errno)) {
+    if (!e || cancelled()) {
+      errno = e ? ECANCELED : errno;
+      rc = -1;
+    } else
+      rc = copy_tree(s, e->d_name, d, e->d_name, buf);
+  }
+  int err = errno;
+  if (d >= 0) {
+    fchmod(d, st.st_mode & 07777);
+    close(d);
+  }
+  if (dir)
+    closedir(dir);
+  else if (s >= 0)
+    close(s);
+  // Like a file, a directory this made goes again if its copy is incomplete
+  if (rc != 0)
+    remove_tree(ddir, dname);
+  errno = err;
+  return rc;
+}
+
+static int remove_tree(int dirfd, const char *name) {
+  if (unlinkat(dirfd, name, 0) == 0)
+    return 0;
+  if (errno != EISDIR && errno != EPERM)
+    return -1;
+  int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+  if (!dir) {
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  int rc = 0;
+  struct dirent *e;
+  while (rc == 0 && ((e = next_entry(dir)) || errno))
+    rc = e ? remove_tree(fd, e->d_name) : -1;
+  int err = errno;
+  closedir(dir);
+  errno = err;
+  return rc == 0 ? unlinkat(dirfd, name, AT_REMOVEDIR) : -1;
+}
+
+// Renames without replacing what is at dest; EXDEV when the two are on
+// different filesystems
+static int rename_new(const char *src, const char *dest) {
+#ifdef RENAME_NOREPLACE
+  if (renameat2(AT_FDCWD, src, AT_FDCWD, dest, RENAME_NOREPLACE) == 0)
+    return 0;
+  // Filesystems that cannot refuse to replace answer EINVAL; for them the
+  // check below leaves a short race
+  if (errno != EINVAL && errno != ENOSYS)
+    return -1;
+#endif
+  struct stat st;
+  if (lstat(dest, &st) == 0) {
+    errno = EEXIST;
+    return -1;
+  }
+  return rename(src, dest);
+}
+
+static const char *base_name(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return slash && slash[1] ? slash + 1 : path;
+}
+
+// Whether dest is path or lies below it
+static bool inside(const char *dest, const char *path) {
+  size_t len = strlen(path);
+  return strncmp(dest, path, len) == 0 &&
+         (dest[len] == '\0' || dest[len] == '/' || (len == 1 && *path == '/'));
+}
+
+static void count_done(void) {
+  pthread_mutex_lock(&op.lock);
+  op.done++;
+  pthread_mutex_unlock(&op.lock);
+}
+
+// Renames what it can, then copies the rest; pending marks the entries
+// left to copy
+static void transfer(bool *pending, char *buf) {
+  char target[PATH_MAX];
+  for (int i = 0; i < op.n_paths && !cancelled(); i++) {
+    const char *name = base_name(op.paths[i]);
+    if (snprintf(target, sizeof(target), "%s/%s", op.dest, name) >=
+        (int)sizeof(target))
+      fail(name, ENAMETOOLONG);
+    else if (inside(op.dest, op.paths[i]))
+      fail(name, EINVAL);
+    else if (!op.move)
+      pending[i] = true;
+    else if (rename_new(op.paths[i], target) != 0) {
+      // Only a move across filesystems is copied
+      if (errno == EXDEV)
+        pending[i] = true;
+      else
+        fail(name, errno);
+    }
+    if (!pending[i])
+      count_done();
+  }
+  long long total = 0;
+  for (int i = 0; i < op.n_paths && !cancelled(); i++)
+    if (pending[i])
+      total += tree_size(AT_FDCWD, op.paths[i]);
+  pthread_mutex_lock(&op.lock);
+  op.total = total;
+  pthread_mutex_unlock(&op.lock);
+  int dest = open(op.dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  for (int i = 0; i < op.n_paths && !cancelled(); i++) {
+    if (!pending[i])
+      continue;
+    const char *name = base_name(op.paths[i]);
+    // The source goes only once its copy is complete
+    int rc = dest < 0 ? -1 : copy_tree(AT_FDCWD, op.paths[i], dest, name, buf);
+    if (rc == 0 && op.move)
+      rc = remove_tree(AT_FDCWD, op.paths[i]);
+    if (rc != 0)
+      fail(name, errno);
+    count_done();
+  }
+  if (dest >= 0)
+    close(dest);
+}
+
+static void *run(void *arg) {
+  (void)arg;
+  char *buf = malloc(BUFFER);
+  bool *pending = calloc(op.n_paths, sizeof(*pending));
+  if (buf && pending)
+    transfer(pending, buf);
+  else
+    fail(op.n_paths ? base_name(op.paths[0]) : "", ENOMEM);
+  free(buf);
+  free(pending);
+  __atomic_store_n(&op.active, false, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&op.lock);
+  op.state = FILEOPS_FINISHED;
+  pthread_mutex_unlock(&op.lock);
+  return NULL;
+}
+
+static void release_paths(void) {
+  for (int i = 0; i < op.n_paths; i++)
+    free(op.paths[i]);
+  free(op.paths);
+  op.paths = NULL;
+  op.n_paths = 0;
+}
+
+// Joins a worker that has ended, with op.lock held
+static void reap(void) {
+  if (op.joinable && op.state != FILEOPS_RUNNING) {
+    pthread_join(op.thread, NULL);
+    op.joinable = false;
+    release_paths();
+  }
+}
+
+bool fileops_start(bool move, char *const *paths, int n, const char *dest) {
+  pthread_mutex_lock(&op.lock);
+  reap();
+  bool busy = op.joinable;
+  pthread_mutex_unlock(&op.lock);
+  if (busy || n <= 0)
+    return false;
+  op.paths = calloc(n, sizeof(*op.paths));
+  for (int i = 0; op.paths && i < n; i++)
+    if (!(op.paths[op.n_paths++] = strdup(paths[i]))) {
+      release_paths();
+      return false;
+    }
+  if (!op.paths)
+    return false;
+  snprintf(op.dest, sizeof(op.dest), "%s", dest);
+  op.move = move;
+  op.cancel = false;
+  op.done = op.failed = 0;
+  op.bytes = op.total = 0;
+  op.current[0] = op.error[0] = '\0';
+  op.state = FILEOPS_RUNNING;
+  __atomic_store_n(&op.active, true, __ATOMIC_RELEASE);
+  // The worker inherits a mask that keeps SIGINT and SIGTERM on the main
+  // thread, whose handler must never find itself on the thread it waits for
+  sigset_t block, old;
+  sigemptyset(&block);
+  sigaddset(&block, SIGINT);
+  sigaddset(&block, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &block, &old);
+  int err = pthread_create(&op.thread, NULL, run, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    __atomic_store_n(&op.active, false, __ATOMIC_RELEASE);
+    op.state = FILEOPS_IDLE;
+    release_paths();
+    return false;
+  }
+  op.joinable = true;
+  return true;
+}
+
+static void format_size(char *buf, size_t size, long long n) {
+  static const char *const units[] = {"B", "KB", "MB", "GB", "TB"};
+  double v = (double)n;
+  int u = 0;
+  while (v >= 1000 && u < 4) {
+    v /= 1000;
+    u++;
+  }
+  snprintf(buf, size, u ? "%.1f %s" : "%.0f %s", v, units[u]);
+}
+
+enum fileops_state fileops_poll(char *buf, size_t size) {
+  const char *verb = op.move ? "Moving" : "Copying";
+  const char *past = op.move ? "Moved" : "Copied";
+  pthread_mutex_lock(&op.lock);
+  enum fileops_state state = op.state;
+  char done[32], total[32];
+  format_size(done, sizeof(done), op.bytes);
+  format_size(total, sizeof(total), op.total);
+  if (state == FILEOPS_RUNNING)
+    snprintf(buf, size, "%s %d of %d%s%s  %s of %s", verb,
+             op.done < op.n_paths ? op.done + 1 : op.n_paths, op.n_paths,
+             op.current[0] ? ": " : "", op.current, done, total);
+  else if (state == FILEOPS_FINISHED && op.failed)
+    snprintf(buf, size, "%s %d of %d; %s", past, op.n_paths - op.failed,
+             op.n_paths, op.error);
+  else if (state == FILEOPS_FINISHED)
+    snprintf(buf, size, "%s %d %s%s%s%s", past, op.n_paths,
+             op.n_paths == 1 ? "entry" : "entries", op.total ? " (" : "",
+             op.total ? total : "", op.total ? ")" : "");
+  if (state == FILEOPS_FINISHED) {
+    op.state = FILEOPS_IDLE;
+    reap();
+  }
+  pthread_mutex_unlock(&op.lock);
+  return state;
+}
+
+bool fileops_interrupt(void) {
+  __atomic_store_n(&op.cancel, true, __ATOMIC_RELAXED);
+  return __atomic_load_n(&op.active, __ATOMIC_ACQUIRE);
+}
+
+void fileops_cancel(void) {
+  __atomic_store_n(&op.cancel, true, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&op.lock);
+  bool joinable = op.joinable;
+  op.joinable = false;
+  pthread_mutex_unlock(&op.lock);
+  if (joinable)
+    pthread_join(op.thread, NULL);
+  release_paths();
+}
+
+#else
+
+#include "fileops.h"
+
+// Copying and moving run on a pthread worker, which Windows goes without
+bool fileops_start(bool move, char *const *paths, int n, const char *dest) {
+  (void)move;
+  (void)paths;
+  (void)n;
+  (void)dest;
+  return false;
+}
+
+enum fileops_state fileops_poll(char *buf, size_t size) {
+  (void)buf;
+  (void)size;
+  return FILEOPS_IDLE;
+}
+
+bool fileops_interrupt(void) { return false; }
+
+void fileops_cancel(void) {}
+
+#endif
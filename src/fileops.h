@@ -0,0 +1,44 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILEOPS_H
+#define FILEOPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Copying and moving entries into a directory on a worker thread, one
+// operation at a time. A file is copied by the cheapest means the
+// filesystems allow: a reflink (FICLONE), then copy_file_range, then
+// sendfile, and a buffered copy only when none of them applies. A move is a
+// rename, which never replaces an existing entry, unless it crosses
+// filesystems; then it is a copy followed by removing the source.
+enum fileops_state { FILEOPS_IDLE, FILEOPS_RUNNING, FILEOPS_FINISHED };
+
+// Takes absolute paths; false when an operation is already running
+bool fileops_start(bool move, char *const *, int, const char *);
+// Writes a status line for the operation running, or for the one that
+// ended, which is reported once
+enum fileops_state fileops_poll(char *, size_t);
+// Asks the worker to stop without waiting for it, which is safe in a signal
+// handler; false when it is no longer touching files
+bool fileops_interrupt(void);
+// Stops the operation, removing the file it was writing
+void fileops_cancel(void);
+
+#endif
@@ -0,0 +1,109 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "filter.h"
+#include "pool.h"
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A compiled pattern, kept by source text and flags. glibc serialises
+// regexec calls on one regex_t behind a lock, so every pool worker gets its
+// own compile of the pattern, made the first time it takes a chunk.
+struct regex_entry {
+  char *source;
+  int cflags, n_workers;
+  unsigned long used;
+  regex_t *compiled;
+  unsigned char *ready; // 1 compiled, 2 failed to compile
+};
+
+static regex_entry cache[FILTER_CACHE_SIZE];
+static unsigned long cache_clock;
+
+static void clear_entry(regex_entry *e) {
+  for (int i = 0; i < e->n_workers; i++)
+    if (e->ready[i] == 1)
+      regfree(&e->compiled[i]);
+  free(e->source);
+  free(e->compiled);
+  free(e->ready);
+  *e = (regex_entry){0};
+}
+
+// Finds the POSIX extended regex for source, smart-case folded when icase
+// is set, or compiles it into the least recently used slot. The first
+// compile happens here, so a bad pattern is reported in err (and NULL
+// returned) before any work is handed out.
+regex_entry *regex_cache_get(const char *source, bool icase, char *err,
+                             size_t err_size) {
+  int cflags = REG_EXTENDED | REG_NOSUB | (icase ? REG_ICASE : 0);
+  regex_entry *victim = &cache[0];
+  for (int i = 0; i < FILTER_CACHE_SIZE; i++) {
+    regex_entry *e = &cache[i];
+    if (e->source && e->cflags == cflags && strcmp(e->source, source) == 0) {
+      e->used = ++cache_clock;
+      return e;
+    }
+    if (!e->source || (victim->source && e->used < victim->used))
+      victim = e;
+  }
+  regex_t probe;
+  int rc = regcomp(&probe, source, cflags);
+  if (rc != 0) {
+    regerror(rc, &probe, err, err_size);
+    return NULL;
+  }
+  clear_entry(victim);
+  int n_workers = pool_workers();
+  victim->compiled = malloc(n_workers * sizeof(*victim->compiled));
+  victim->ready = calloc(n_workers, 1);
+  victim->source = strdup(source);
+  if (!victim->compiled || !victim->ready || !victim->source) {
+    regfree(&probe);
+    clear_entry(victim);
+    snprintf(err, err_size, "out of memory");
+    return NULL;
+  }
+  victim->n_workers = n_workers;
+  victim->cflags = cflags;
+  victim->used = ++cache_clock;
+  victim->compiled[0] = probe;
+  victim->ready[0] = 1;
+  return victim;
+}
+
+// Writes the indices in [lo, hi) of the names re matches to out and returns
+// how many there are. Safe to call concurrently from distinct pool workers.
+int regex_match_range(regex_entry *re, int worker, char *const names[], int lo,
+                      int hi, int *out) {
+  int k = 0;
+  if (!re->ready[worker])
+    re->ready[worker] =
+        regcomp(&re->compiled[worker], re->source, re->cflags) == 0 ? 1 : 2;
+  if (re->ready[worker] == 1)
+    for (int i = lo; i < hi; i++)
+      if (regexec(&re->compiled[worker], names[i], 0, NULL, 0) == 0)
+        out[k++] = i;
+  return k;
+}
+
+void regex_filter_cache_free(void) {
+  for (int i = 0; i < FILTER_CACHE_SIZE; i++)
+    clear_entry(&cache[i]);
+}
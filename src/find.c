@@ -0,0 +1,202 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "find.h"
+#include "fold.h"
+#include "fuzzy.h"
+#include "treeindex.h"
+#include "walk.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIND_MAX_DEPTH 32
+#define FIND_POLL_MS 50
+
+// Candidate paths streamed in by the walker, their folded forms, and the
+// matches for the current query over the first n_scanned of them.
+typedef struct find_state {
+  char **paths, **folded;
+  int n_paths, cap_paths, cap_folded;
+  fuzzy_result *set, *ranked;
+  int n_set, cap_set, n_scanned;
+} find_state;
+
+static bool grow_results(find_state *st) {
+  if (st->cap_set >= st->n_paths)
+    return true;
+  int cap = st->n_paths;
+  fuzzy_result *set = realloc(st->set, cap * sizeof(*set));
+  if (!set)
+    return false;
+  st->set = set;
+  fuzzy_result *ranked = realloc(st->ranked, cap * sizeof(*ranked));
+  if (!ranked)
+    return false;
+  st->ranked = ranked;
+  st->cap_set = cap;
+  return true;
+}
+
+static bool take_paths(walker *w, find_state *st) {
+  int before = st->n_paths;
+  if (!walk_take(w, &st->paths, &st->n_paths, &st->cap_paths))
+    return false;
+  if (st->cap_folded < st->cap_paths) {
+    char **tmp = realloc(st->folded, st->cap_paths * sizeof(*tmp));
+    if (!tmp) {
+      for (int i = before; i < st->n_paths; i++)
+        free(st->paths[i]);
+      st->n_paths = before;
+      return false;
+    }
+    st->folded = tmp;
+    st->cap_folded = st->cap_paths;
+  }
+  for (int i = before; i < st->n_paths; i++)
+    if (!(st->folded[i] = fold_dup(st->paths[i])))
+      st->folded[i] = strdup("");
+  return true;
+}
+
+// Rescores everything when refilter is set (or only the previous matches
+// when the query just grew), then scores the paths that arrived since.
+static void update_matches(find_state *st, const fuzzy_pattern *pat,
+                           bool refilter, bool refine) {
+  if (!grow_results(st))
+    return;
+  if (refilter)
+    st->n_set = fuzzy_filter(pat, st->paths, st->folded, st->n_scanned,
+                             refine ? st->set : NULL, st->n_set, st->set);
+  if (st->n_scanned < st->n_paths) {
+    int base = st->n_scanned;
+    int got = fuzzy_filter(pat, st->paths + base, st->folded + base,
+                           st->n_paths - base, NULL, 0, st->set + st->n_set);
+    for (int i = 0; i < got; i++)
+      st->set[st->n_set + i].index += base;
+    st->n_set += got;
+    st->n_scanned = st->n_paths;
+  }
+  memcpy(st->ranked, st->set, st->n_set * sizeof(*st->ranked));
+  fuzzy_sort(st->ranked, st->n_set);
+}
+
+// Recursive find-as-you-type under the current directory. Paths are fuzzy
+// matched while the walk is still streaming them in. On Enter the chosen
+// path, relative to the current directory, is copied to out.
+bool handle_find(WINDOW *menu_win, bool show_hidden, char *out, size_t size) {
+  char index_file[PATH_MAX];
+  walk_options opts = {FIND_MAX_DEPTH, 0, show_hidden, true, false, NULL};
+  if (!getenv("FEX_NO_INDEX") &&
+      tree_index_path(".", index_file, sizeof(index_file)))
+    opts.index_file = index_file;
+  walker *w = walk_start(".", &opts);
+  if (!w)
+    return false;
+  find_state st = {0};
+  char query[FUZZY_MAX_QUERY] = {0};
+  int pos = 0, c = 0, selected = 0, last_len = 0;
+  bool walking = true, chosen = false, query_changed = true;
+  fuzzy_pattern pat;
+  const int visible_count = 10;
+  wtimeout(menu_win, FIND_POLL_MS);
+  while (1) {
+    bool grew = take_paths(w, &st);
+    if (walking && walk_finished(w)) {
+      walking = false;
+      wtimeout(menu_win, -1);
+    }
+    if (query_changed || grew) {
+      fuzzy_compile(&pat, query);
+      update_matches(&st, &pat, query_changed,
+                     query_changed && pos > last_len && last_len > 0);
+      last_len = pos;
+      query_changed = false;
+    }
+
+    for (int i = LINES - (visible_count + 2); i < LINES; i++) {
+      move(i, 0);
+      clrtoeol();
+    }
+    if (st.n_set > 0) {
+      if (selected >= st.n_set)
+        selected = st.n_set - 1;
+      int first = selected - visible_count / 2;
+      if (first > st.n_set - visible_count)
+        first = st.n_set - visible_count;
+      if (first < 0)
+        first = 0;
+      for (int i = first; i < first + visible_count && i < st.n_set; i++) {
+        if (i == selected)
+          attron(A_REVERSE);
+        mvprintw(LINES - (visible_count + 1) + (i - first), 0, "%s",
+                 st.paths[st.ranked[i].index]);
+        if (i == selected)
+          attroff(A_REVERSE);
+      }
+    } else if (!walking)
+      mvprintw(LINES - (visible_count + 1), 0, "No matches");
+    mvprintw(LINES - 1, 0, "find/%s", query);
+    printw("  %d/%d%s", st.n_set ? selected + 1 : 0, st.n_set,
+           walking ? " ..." : "");
+    refresh();
+
+    c = wgetch(menu_win);
+    if (c == ERR)
+      continue;
+    if (c == '\n' || c == 27)
+      break;
+    if ((c == KEY_BACKSPACE || c == 127) && pos > 0) {
+      query[--pos] = '\0';
+      last_len = -1;
+      query_changed = true;
+    } else if (c == KEY_UP) {
+      if (st.n_set)
+        selected = (selected - 1 + st.n_set) % st.n_set;
+    } else if (c == KEY_DOWN) {
+      if (st.n_set)
+        selected = (selected + 1) % st.n_set;
+    } else if (c >= ' ' && c < KEY_MIN && c != 127 &&
+               pos < (int)sizeof(query) - 1) {
+      query[pos++] = (char)c;
+      query[pos] = '\0';
+      query_changed = true;
+      selected = 0;
+    }
+  }
+  if (c == '\n' && st.n_set > 0) {
+    snprintf(out, size, "%s", st.paths[st.ranked[selected].index]);
+    chosen = true;
+  }
+  wtimeout(menu_win, -1);
+  walk_stop(w);
+  for (int i = 0; i < st.n_paths; i++) {
+    free(st.paths[i]);
+    free(st.folded[i]);
+  }
+  free(st.paths);
+  free(st.folded);
+  free(st.set);
+  free(st.ranked);
+  for (int i = LINES - (visible_count + 2); i < LINES; i++) {
+    move(i, 0);
+    clrtoeol();
+  }
+  refresh();
+  return chosen;
+}
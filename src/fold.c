@@ -0,0 +1,79 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "fold.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Simple case folding for the scripts whose upper and lower case letters
+// both encode to two UTF-8 bytes (Latin-1, Latin Extended-A, Greek and
+// Cyrillic), plus ASCII. Keeping the encoded length unchanged means byte
+// offsets into a folded name are also valid offsets into the original.
+static unsigned int fold_rune(unsigned int r) {
+  if (r >= 'A' && r <= 'Z')
+    return r + ('a' - 'A');
+  if (r >= 0xc0 && r <= 0xde && r != 0xd7)
+    return r + 0x20;
+  if ((r >= 0x100 && r <= 0x137) || (r >= 0x14a && r <= 0x177))
+    return r | 1;
+  if ((r >= 0x139 && r <= 0x148) || (r >= 0x179 && r <= 0x17e))
+    return (r & 1) ? r + 1 : r;
+  if (r == 0x178)
+    return 0xff;
+  if (r >= 0x391 && r <= 0x3ab && r != 0x3a2)
+    return r + 0x20;
+  if (r >= 0x410 && r <= 0x42f)
+    return r + 0x20;
+  if (r >= 0x400 && r <= 0x40f)
+    return r + 0x50;
+  return r;
+}
+
+// Folds in into out, which must have room for strlen(in) + 1 bytes. Bytes
+// that are not part of a foldable character, including invalid UTF-8, are
+// copied unchanged. Returns whether anything was folded.
+bool fold_utf8(const char *in, char *out) {
+  const unsigned char *s = (const unsigned char *)in;
+  unsigned char *d = (unsigned char *)out;
+  bool changed = false;
+  while (*s) {
+    unsigned int r;
+    if (*s < 0x80) {
+      r = fold_rune(*s);
+      changed |= r != *s;
+      *d++ = (unsigned char)r;
+      s++;
+    } else if (*s >= 0xc2 && *s <= 0xdf && (s[1] & 0xc0) == 0x80) {
+      unsigned int orig = ((s[0] & 0x1fu) << 6) | (s[1] & 0x3fu);
+      r = fold_rune(orig);
+      changed |= r != orig;
+      *d++ = (unsigned char)(0xc0 | (r >> 6));
+      *d++ = (unsigned char)(0x80 | (r & 0x3f));
+      s += 2;
+    } else
+      *d++ = *s++;
+  }
+  *d = '\0';
+  return changed;
+}
+
+char *fold_dup(const char *in) {
+  char *out = malloc(strlen(in) + 1);
+  if (out)
+    fold_utf8(in, out);
+  return out;
+}
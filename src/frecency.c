@@ -0,0 +1,388 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#include "frecency.h"
+#include "fold.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Hits beyond this in total are scaled down when the log is compacted, so
+// old favourites fade; entries scaled to nothing drop out unless visited
+// within the last week
+#define FRECENCY_MAX_HITS 100000
+#define FRECENCY_WEEK 604800
+// Records the log may hold beyond two per directory before a compaction
+#define FRECENCY_SLACK 1024
+#define FRECENCY_MAX_KEYWORDS 16
+
+// One visit, or after compaction one directory. The path follows, NUL
+// terminated and padded so the next record is 8-byte aligned.
+typedef struct visit_record {
+  uint32_t len, hits;
+  int64_t last;
+} visit_record;
+
+static char log_file[PATH_MAX + 16];
+static int log_fd = -1;
+
+static size_t record_size(size_t len) {
+  return (sizeof(visit_record) + len + 1 + 7) & ~(size_t)7;
+}
+
+static bool store_path(void) {
+  if (log_file[0])
+    return true;
+  const char *data = getenv("XDG_DATA_HOME"), *home = getenv("HOME");
+  char dir[PATH_MAX];
+  int n;
+  if (data && *data == '/')
+    n = snprintf(dir, sizeof(dir), "%s/fex", data);
+  else if (home && *home)
+    n = snprintf(dir, sizeof(dir), "%s/.local/share/fex", home);
+  else
+    return false;
+  if (n <= 0 || (size_t)n >= sizeof(dir) - sizeof("/frecency"))
+    return false;
+  for (char *p = dir + 1;; p++) {
+    if (*p && *p != '/')
+      continue;
+    char end = *p;
+    *p = '\0';
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+      return false;
+    if (!(*p = end))
+      break;
+  }
+  snprintf(log_file, sizeof(log_file), "%s/frecency", dir);
+  return true;
+}
+
+static bool write_record(int fd, const char *path, size_t len,
+                         unsigned int hits, long long last) {
+  char buf[sizeof(visit_record) + PATH_MAX + 8] = {0};
+  visit_record rec = {(uint32_t)len, hits, last};
+  memcpy(buf, &rec, sizeof(rec));
+  memcpy(buf + sizeof(rec), path, len);
+  size_t size = record_size(len);
+  return write(fd, buf, size) == (ssize_t)size;
+}
+
+// Appends a visit of dir, an absolute path. Appends are single writes to an
+// O_APPEND descriptor, so concurrent sessions interleave whole records.
+void frecency_visit(const char *dir) {
+  size_t len = strlen(dir);
+  if (!len || len >= PATH_MAX || !store_path())
+    return;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (log_fd < 0 &&
+        (log_fd = open(log_file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                       0600)) < 0)
+      return;
+    // A compaction renames a new log over this one under an exclusive
+    // lock; a visit appended to the replaced file would be lost
+    struct stat a, b;
+    flock(log_fd, LOCK_SH);
+    bool current = fstat(log_fd, &a) == 0 && stat(log_file, &b) == 0 &&
+                   a.st_ino == b.st_ino && a.st_dev == b.st_dev;
+    if (current)
+      write_record(log_fd, dir, len, 1, (long long)time(NULL));
+    flock(log_fd, LOCK_UN);
+    if (current)
+      return;
+    close(log_fd);
+    log_fd = -1;
+  }
+}
+
+static uint32_t hash_path(const char *s) {
+  uint32_t h = 2166136261u;
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+static uint64_t byte_mask(const char *s) {
+  uint64_t mask = 0;
+  while (*s)
+    mask |= 1ULL << ((unsigned char)*s++ & 63);
+  return mask;
+}
+
+// Same for pairs of adjacent bytes, which tells names apart far better
+static uint64_t pair_mask(const char *s) {
+  uint64_t mask = 0;
+  for (; s[0] && s[1]; s++)
+    mask |= 1ULL << (((unsigned char)s[0] * 31 + (unsigned char)s[1]) & 63);
+  return mask;
+}
+
+static double frecency_score(unsigned int hits, long long last,
+                             long long now) {
+  long long age = now - last;
+  if (age < 3600)
+    return hits * 4.0;
+  if (age < 86400)
+    return hits * 2.0;
+  if (age < FRECENCY_WEEK)
+    return hits * 0.5;
+  return hits * 0.25;
+}
+
+static int by_score(const void *a, const void *b) {
+  const frecency_entry *ea = a, *eb = b;
+  if (ea->score != eb->score)
+    return ea->score < eb->score ? 1 : -1;
+  return (ea->last < eb->last) - (ea->last > eb->last);
+}
+
+// Rewrites the log with one record per entry, replacing it by rename while
+// the caller holds the exclusive lock on the old one.
+static void compact(const frecency_entry *entries, int n) {
+  char tmp[PATH_MAX + 32];
+  snprintf(tmp, sizeof(tmp), "%s.%ld", log_file, (long)getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return;
+  bool ok = true;
+  for (int i = 0; i < n && ok; i++)
+    ok = write_record(fd, entries[i].path, strlen(entries[i].path),
+                      entries[i].hits, entries[i].last);
+  if (close(fd) != 0 || !ok || rename(tmp, log_file) != 0)
+    unlink(tmp);
+}
+
+// Folds the log into db, one entry per directory, and compacts it when it
+// holds many more records than directories or ends in a torn record. A
+// missing log loads as an empty db.
+bool frecency_load(frecency_db *db) {
+  *db = (frecency_db){0};
+  if (!store_path())
+    return false;
+  int fd = open(log_file, O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+    return errno == ENOENT;
+  flock(fd, LOCK_EX);
+  struct stat st;
+  const unsigned char *map = NULL;
+  size_t size = 0;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    size = st.st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    map = p == MAP_FAILED ? NULL : p;
+  }
+  if (!map) {
+    flock(fd, LOCK_UN);
+    close(fd);
+    return size == 0;
+  }
+
+  // Aggregate by path; paths point into the map until copied out below
+  size_t n_records = 0, off = 0, cap = 1024, n_slots = 2048, strings_size = 0;
+  frecency_entry *entries = malloc(cap * sizeof(*entries));
+  uint32_t *slots = calloc(n_slots, sizeof(*slots));
+  bool ok = entries && slots;
+  while (ok && off + sizeof(visit_record) <= size) {
+    visit_record rec;
+    memcpy(&rec, map + off, sizeof(rec));
+    if (!rec.len || rec.len >= PATH_MAX ||
+        record_size(rec.len) > size - off ||
+        map[off + sizeof(rec) + rec.len] != '\0')
+      break;
+    const char *path = (const char *)map + off + sizeof(rec);
+    off += record_size(rec.len);
+    n_records++;
+    uint32_t h = hash_path(path) & (n_slots - 1);
+    while (slots[h] && strcmp(entries[slots[h] - 1].path, path) != 0)
+      h = (h + 1) & (n_slots - 1);
+    if (slots[h]) {
+      frecency_entry *e = &entries[slots[h] - 1];
+      e->hits += rec.hits;
+      if (rec.last > e->last)
+        e->last = rec.last;
+      continue;
+    }
+    if ((size_t)db->n_entries == cap) {
+      frecency_entry *tmp = realloc(entries, (cap *= 2) * sizeof(*tmp));
+      if (!(ok = tmp != NULL))
+        break;
+      entries = tmp;
+    }
+    entries[db->n_entries] = (frecency_entry){
+        .path = (char *)path, .hits = rec.hits, .last = rec.last};
+    slots[h] = ++db->n_entries;
+    strings_size += 2 * (rec.len + 1);
+    if ((size_t)db->n_entries * 2 > n_slots) {
+      free(slots);
+      n_slots *= 2;
+      if (!(ok = (slots = calloc(n_slots, sizeof(*slots))) != NULL))
+        break;
+      for (int i = 0; i < db->n_entries; i++) {
+        uint32_t k = hash_path(entries[i].path) & (n_slots - 1);
+        while (slots[k])
+          k = (k + 1) & (n_slots - 1);
+        slots[k] = i + 1;
+      }
+    }
+  }
+  free(slots);
+
+  long long now = time(NULL), total = 0;
+  for (int i = 0; ok && i < db->n_entries; i++)
+    total += entries[i].hits;
+  bool aged = ok && total > FRECENCY_MAX_HITS;
+  if (aged) {
+    double factor = 0.9 * FRECENCY_MAX_HITS / total;
+    int kept = 0;
+    for (int i = 0; i < db->n_entries; i++) {
+      entries[i].hits = (unsigned int)(entries[i].hits * factor);
+      if (!entries[i].hits && now - entries[i].last < FRECENCY_WEEK)
+        entries[i].hits = 1;
+      if (entries[i].hits)
+        entries[kept++] = entries[i];
+    }
+    db->n_entries = kept;
+  }
+  if (ok && (aged || off < size ||
+             n_records > (size_t)db->n_entries * 2 + FRECENCY_SLACK))
+    compact(entries, db->n_entries);
+
+  // Copy the paths and their folded forms out of the map
+  char *s = ok ? (db->strings = malloc(strings_size + 1)) : NULL;
+  for (int i = 0; s && i < db->n_entries; i++) {
+    frecency_entry *e = &entries[i];
+    size_t len = strlen(e->path) + 1;
+    memcpy(s, e->path, len);
+    const char *slash = strrchr(e->path, '/');
+    e->base = slash ? (unsigned int)(slash + 1 - e->path) : 0;
+    e->path = s;
+    e->folded = s + len;
+    fold_utf8(e->path, e->folded);
+    e->path_mask = byte_mask(e->folded);
+    e->base_mask = pair_mask(e->folded + e->base);
+    s += 2 * len;
+    e->score = frecency_score(e->hits, e->last, now);
+  }
+  munmap((void *)map, size);
+  flock(fd, LOCK_UN);
+  close(fd);
+  if (!s) {
+    free(entries);
+    *db = (frecency_db){0};
+    return false;
+  }
+  qsort(entries, db->n_entries, sizeof(*entries), by_score);
+  db->entries = entries;
+  return true;
+}
+
+void frecency_free(frecency_db *db) {
+  free(db->entries);
+  free(db->strings);
+  *db = (frecency_db){0};
+}
+
+// Whether path holds every keyword in order, the last one inside its final
+// component, as zoxide does; a query naming the tail of a path thus ranks
+// that directory rather than the ones below it.
+static bool keywords_match(const char *path, const char *base,
+                           char *const keywords[], int n) {
+  if (!strstr(base, keywords[n - 1]))
+    return false;
+  const char *p = path;
+  for (int i = 0; i < n; i++) {
+    if (i == n - 1 && p < base)
+      p = base;
+    if (!(p = strstr(p, keywords[i])))
+      return false;
+    p += strlen(keywords[i]);
+  }
+  return true;
+}
+
+// Writes the indices of the best max entries matching the space-separated
+// keywords of query to out, best first, and returns how many there are.
+// Matching is smart-case, as in the search overlay.
+int frecency_query(const frecency_db *db, const char *query, int *out,
+                   int max) {
+  char buf[PATH_MAX], *keywords[FRECENCY_MAX_KEYWORDS], *save;
+  if (strlen(query) >= sizeof(buf))
+    return 0;
+  bool sensitive = fold_utf8(query, buf);
+  // Masks come from the folded forms, which a case-sensitive match implies
+  uint64_t path_mask = byte_mask(buf), base_mask = 0;
+  if (sensitive)
+    strcpy(buf, query);
+  int n_keywords = 0, count = 0;
+  for (char *k = strtok_r(buf, " ", &save);
+       k && n_keywords < FRECENCY_MAX_KEYWORDS; k = strtok_r(NULL, " ", &save))
+    keywords[n_keywords++] = k;
+  path_mask &= ~(1ULL << (' ' & 63));
+  if (n_keywords) {
+    char last[PATH_MAX];
+    fold_utf8(keywords[n_keywords - 1], last);
+    base_mask = pair_mask(last);
+  }
+  // Entries are in score order, so the first max matches are the best
+  for (int i = 0; i < db->n_entries && count < max; i++) {
+    const frecency_entry *e = &db->entries[i];
+    if ((e->path_mask & path_mask) != path_mask ||
+        (e->base_mask & base_mask) != base_mask)
+      continue;
+    const char *path = sensitive ? e->path : e->folded;
+    if (!n_keywords ||
+        keywords_match(path, path + e->base, keywords, n_keywords))
+      out[count++] = i;
+  }
+  return count;
+}
+
+#else
+
+#include "frecency.h"
+
+// Visits are not recorded on Windows, so the jump list stays empty
+void frecency_visit(const char *dir) { (void)dir; }
+
+bool frecency_load(frecency_db *db) {
+  *db = (frecency_db){0};
+  return true;
+}
+
+void frecency_free(frecency_db *db) { (void)db; }
+
+int frecency_query(const frecency_db *db, const char *query, int *out,
+                   int max) {
+  (void)db;
+  (void)query;
+  (void)out;
+  (void)max;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Directories visited, ranked by frecency: how often, weighted by how
+// recently. The store is an append-only log of visit records under
+// $XDG_DATA_HOME/fex; it is mapped and folded into one entry per directory
+// when loaded, and rewritten that way when the log has grown well past the
+// number of directories in it.
+typedef struct frecency_entry {
+  char *path, *folded;
+  // Bytes present in the folded path, one bit per byte value modulo 64, and
+  // likewise pairs of adjacent bytes in its final component, to reject most
+  // entries without reading their strings
+  uint64_t path_mask, base_mask;
+  unsigned int base; // offset of the final path component
+  unsigned int hits;
+  long long last;
+  double score;
+} frecency_entry;
+
+// Entries are kept from the highest score down
+typedef struct frecency_db {
+  frecency_entry *entries;
+  char *strings;
+  int n_entries;
+} frecency_db;
+
+void frecency_visit(const char *);
+bool frecency_load(frecency_db *);
+void frecency_free(frecency_db *);
+int frecency_query(const frecency_db *, const char *, int *, int);
+
+#endif
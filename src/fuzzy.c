@@ -0,0 +1,305 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "fuzzy.h"
+#include "fold.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Scoring follows fzf's v1 algorithm: every matched byte is worth
+// SCORE_MATCH, gaps are penalised, and matches right after a word boundary
+// or inside a contiguous run earn a bonus.
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_BOUNDARY_WHITE (BONUS_BOUNDARY + 2)
+#define BONUS_BOUNDARY_DELIMITER (BONUS_BOUNDARY + 1)
+#define BONUS_NON_WORD (SCORE_MATCH / 2)
+#define BONUS_CAMEL123 (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+typedef enum {
+  CHAR_WHITE,
+  CHAR_NON_WORD,
+  CHAR_DELIMITER,
+  CHAR_LOWER,
+  CHAR_UPPER,
+  CHAR_NUMBER,
+} char_class;
+
+static char_class class_of(unsigned char c) {
+  if (c >= 'a' && c <= 'z')
+    return CHAR_LOWER;
+  if (c >= 'A' && c <= 'Z')
+    return CHAR_UPPER;
+  if (c >= '0' && c <= '9')
+    return CHAR_NUMBER;
+  if (c == ' ' || c == '\t')
+    return CHAR_WHITE;
+  if (c == '/' || c == ',' || c == ':' || c == ';' || c == '|')
+    return CHAR_DELIMITER;
+  if (c >= 0x80)
+    return CHAR_LOWER;
+  return CHAR_NON_WORD;
+}
+
+static int bonus_for(char_class prev, char_class cur) {
+  if (cur > CHAR_DELIMITER) {
+    if (prev == CHAR_WHITE)
+      return BONUS_BOUNDARY_WHITE;
+    if (prev == CHAR_DELIMITER)
+      return BONUS_BOUNDARY_DELIMITER;
+    if (prev == CHAR_NON_WORD)
+      return BONUS_BOUNDARY;
+  }
+  if ((prev == CHAR_LOWER && cur == CHAR_UPPER) ||
+      (prev != CHAR_NUMBER && cur == CHAR_NUMBER))
+    return BONUS_CAMEL123;
+  if (cur == CHAR_NON_WORD || cur == CHAR_DELIMITER)
+    return BONUS_NON_WORD;
+  if (cur == CHAR_WHITE)
+    return BONUS_BOUNDARY_WHITE;
+  return 0;
+}
+
+static unsigned char fold(unsigned char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+void fuzzy_compile(fuzzy_pattern *pat, const char *query) {
+  char raw[FUZZY_MAX_QUERY];
+  size_t len = strlen(query);
+  if (len > sizeof(raw) - 1)
+    len = sizeof(raw) - 1;
+  memcpy(raw, query, len);
+  raw[len] = '\0';
+  pat->case_sensitive = fold_utf8(raw, pat->text);
+  if (pat->case_sensitive)
+    memcpy(pat->text, raw, len + 1);
+  pat->len = (int)len;
+}
+
+// First occurrence of a or b in [s, end), sixteen bytes at a time when SSE2
+// is available.
+static const char *find_either(const char *s, const char *end, unsigned char a,
+                               unsigned char b) {
+#ifdef __SSE2__
+  const __m128i va = _mm_set1_epi8((char)a), vb = _mm_set1_epi8((char)b);
+  while (end - s >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)s);
+    int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+    if (mask)
+      return s + __builtin_ctz((unsigned)mask);
+    s += 16;
+  }
+#endif
+  for (; s < end; s++)
+    if ((unsigned char)*s == a || (unsigned char)*s == b)
+      return s;
+  return NULL;
+}
+
+// Cheap rejection pass run before any scoring: checks that the query bytes
+// occur in the candidate in order. With exact unset, ASCII letters match
+// either case. Returns the offset just past the earliest complete match, or
+// -1 if the candidate cannot match.
+static int prefilter(const char *cand, size_t len, const fuzzy_pattern *pat,
+                     bool exact) {
+  const char *s = cand, *end = cand + len;
+  for (int i = 0; i < pat->len; i++) {
+    unsigned char q = (unsigned char)pat->text[i];
+    unsigned char alt = q;
+    if (!exact && q >= 'a' && q <= 'z')
+      alt = q - ('a' - 'A');
+    s = find_either(s, end, q, alt);
+    if (!s)
+      return -1;
+    s++;
+  }
+  return (int)(s - cand);
+}
+
+static bool same(unsigned char c, unsigned char q, bool exact) {
+  return exact ? c == q : fold(c) == q;
+}
+
+// Matches against the candidate's precomputed folded form when one is given
+// and the query is case-insensitive, so no byte has to be folded here.
+// Character classes for the bonuses always come from the original bytes.
+bool fuzzy_match(const char *cand, const char *folded, size_t len,
+                 const fuzzy_pattern *pat, int *score) {
+  bool exact = pat->case_sensitive || folded;
+  const char *text = pat->case_sensitive || !folded ? cand : folded;
+  int end = prefilter(text, len, pat, exact);
+  if (end < 0)
+    return false;
+  if (pat->len == 0) {
+    *score = 0;
+    return true;
+  }
+
+  // Walk back from the end of the forward match to find the shortest window
+  // holding the whole query
+  int start = end - 1, pidx = pat->len - 1;
+  for (; start >= 0; start--)
+    if (same((unsigned char)text[start], (unsigned char)pat->text[pidx],
+             exact) &&
+        --pidx < 0)
+      break;
+
+  int total = 0, consecutive = 0, first_bonus = 0;
+  bool in_gap = false;
+  char_class prev =
+      start > 0 ? class_of((unsigned char)cand[start - 1]) : CHAR_WHITE;
+  pidx = 0;
+  for (int i = start; i < end; i++) {
+    char_class cls = class_of((unsigned char)cand[i]);
+    if (pidx < pat->len &&
+        same((unsigned char)text[i], (unsigned char)pat->text[pidx], exact)) {
+      int bonus = bonus_for(prev, cls);
+      total += SCORE_MATCH;
+      if (consecutive == 0)
+        first_bonus = bonus;
+      else {
+        if (bonus >= BONUS_BOUNDARY && bonus > first_bonus)
+          first_bonus = bonus;
+        if (first_bonus > bonus)
+          bonus = first_bonus;
+        if (BONUS_CONSECUTIVE > bonus)
+          bonus = BONUS_CONSECUTIVE;
+      }
+      total += pidx == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus;
+      in_gap = false;
+      consecutive++;
+      pidx++;
+    } else {
+      total += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+      in_gap = true;
+      consecutive = 0;
+      first_bonus = 0;
+    }
+    prev = cls;
+  }
+  *score = total;
+  return true;
+}
+
+static int cmp_results(const void *a, const void *b) {
+  const fuzzy_result *ra = a, *rb = b;
+  if (ra->score != rb->score)
+    return rb->score - ra->score;
+  if (ra->len != rb->len)
+    return ra->len - rb->len;
+  return ra->index - rb->index;
+}
+
+// Negative when a ranks before b
+int fuzzy_compare(const fuzzy_result *a, const fuzzy_result *b) {
+  return cmp_results(a, b);
+}
+
+// Rank order packed into one integer: higher score, then shorter candidate,
+// then lower index.
+static uint64_t rank_key(const fuzzy_result *r) {
+  int score = r->score + 0x8000;
+  if (score < 0)
+    score = 0;
+  else if (score > 0xffff)
+    score = 0xffff;
+  uint64_t len = r->len > 0xffff ? 0xffff : (uint64_t)r->len;
+  return ((uint64_t)(0xffff - score) << 48) | (len << 32) | (uint32_t)r->index;
+}
+
+// Orders results by rank. The input is expected in candidate order, so large
+// sets only need a stable LSD radix sort over the score and length half of
+// rank_key, 16 bits per pass, skipping passes in which every key has the same
+// digit. Falls back to qsort when the scratch buffers cannot be allocated.
+void fuzzy_sort(fuzzy_result *res, int n) {
+  if (n < 4096) {
+    qsort(res, n, sizeof(*res), cmp_results);
+    return;
+  }
+  uint64_t *keys = malloc(2 * n * sizeof(*keys));
+  fuzzy_result *tmp = malloc(n * sizeof(*tmp));
+  unsigned int *counts = malloc(65536 * sizeof(*counts));
+  if (!keys || !tmp || !counts) {
+    free(keys);
+    free(tmp);
+    free(counts);
+    qsort(res, n, sizeof(*res), cmp_results);
+    return;
+  }
+  uint64_t *ksrc = keys, *kdst = keys + n;
+  fuzzy_result *src = res, *dst = tmp;
+  for (int i = 0; i < n; i++)
+    ksrc[i] = rank_key(&res[i]);
+  for (int shift = 32; shift < 64; shift += 16) {
+    memset(counts, 0, 65536 * sizeof(*counts));
+    for (int i = 0; i < n; i++)
+      counts[(ksrc[i] >> shift) & 0xffff]++;
+    if (counts[(ksrc[0] >> shift) & 0xffff] == (unsigned int)n)
+      continue;
+    unsigned int sum = 0;
+    for (int d = 0; d < 65536; d++) {
+      unsigned int c = counts[d];
+      counts[d] = sum;
+      sum += c;
+    }
+    for (int i = 0; i < n; i++) {
+      unsigned int at = counts[(ksrc[i] >> shift) & 0xffff]++;
+      kdst[at] = ksrc[i];
+      dst[at] = src[i];
+    }
+    uint64_t *kt = ksrc;
+    ksrc = kdst;
+    kdst = kt;
+    fuzzy_result *t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != res)
+    memcpy(res, src, n * sizeof(*res));
+  free(keys);
+  free(tmp);
+  free(counts);
+}
+
+// Keeps the candidates matching pat, either out of all of them or, when the
+// query merely grew since prev was computed, out of prev alone. folded holds
+// the candidates' case-folded forms and may be NULL. Matches are written to
+// out in candidate order; out may be the same array as prev. Returns the
+// number of matches.
+int fuzzy_filter(const fuzzy_pattern *pat, char *const cands[],
+                 char *const folded[], int n_cands, const fuzzy_result *prev,
+                 int n_prev, fuzzy_result *out) {
+  int n = prev ? n_prev : n_cands, count = 0;
+  for (int i = 0; i < n; i++) {
+    int index = prev ? prev[i].index : i, score;
+    size_t len = prev ? (size_t)prev[i].len : strlen(cands[index]);
+    if (fuzzy_match(cands[index], folded ? folded[index] : NULL, len, pat,
+                    &score))
+      out[count++] = (fuzzy_result){index, score, (int)len};
+  }
+  return count;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FUZZY_MAX_QUERY 256
+
+// A compiled query. Matching is smart-case: a query that case folding leaves
+// unchanged matches case-insensitively, and text then holds its folded form.
+typedef struct fuzzy_pattern {
+  char text[FUZZY_MAX_QUERY];
+  int len;
+  bool case_sensitive;
+} fuzzy_pattern;
+
+typedef struct fuzzy_result {
+  int index;
+  int score;
+  int len;
+} fuzzy_result;
+
+void fuzzy_compile(fuzzy_pattern *, const char *);
+bool fuzzy_match(const char *, const char *, size_t, const fuzzy_pattern *,
+                 int *);
+int fuzzy_filter(const fuzzy_pattern *, char *const[], char *const[], int,
+                 const fuzzy_result *, int, fuzzy_result *);
+void fuzzy_sort(fuzzy_result *, int);
+int fuzzy_compare(const fuzzy_result *, const fuzzy_result *);
+
+#endif
@@ -0,0 +1,98 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "jump.h"
+#include "frecency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JUMP_ROWS 10
+#define JUMP_MAX_QUERY 256
+
+// Jump to a directory visited before. The visited directories matching the
+// typed keywords are listed by frecency; on Enter the chosen one is copied
+// to out.
+bool handle_jump(WINDOW *menu_win, char *out, size_t size) {
+  frecency_db db;
+  if (!frecency_load(&db))
+    return false;
+  const char *home = getenv("HOME");
+  size_t home_len = home ? strlen(home) : 0;
+  char query[JUMP_MAX_QUERY] = {0};
+  int results[JUMP_ROWS], n = 0, pos = 0, c = 0, selected = 0;
+  bool chosen = false, query_changed = true;
+  while (1) {
+    if (query_changed) {
+      n = frecency_query(&db, query, results, JUMP_ROWS);
+      selected = 0;
+      query_changed = false;
+    }
+    for (int i = LINES - (JUMP_ROWS + 2); i < LINES; i++) {
+      move(i, 0);
+      clrtoeol();
+    }
+    for (int i = 0; i < n; i++) {
+      const char *path = db.entries[results[i]].path;
+      if (i == selected)
+        attron(A_REVERSE);
+      // Show the home directory as ~ to keep long paths readable
+      if (home_len > 1 && strncmp(path, home, home_len) == 0 &&
+          (path[home_len] == '/' || !path[home_len]))
+        mvprintw(LINES - (JUMP_ROWS + 1) + i, 0, "~%s", path + home_len);
+      else
+        mvprintw(LINES - (JUMP_ROWS + 1) + i, 0, "%s", path);
+      if (i == selected)
+        attroff(A_REVERSE);
+    }
+    if (!n)
+      mvprintw(LINES - (JUMP_ROWS + 1), 0,
+               db.n_entries ? "No matches" : "No directories visited yet");
+    mvprintw(LINES - 1, 0, "z/%s", query);
+    refresh();
+
+    c = wgetch(menu_win);
+    if (c == '\n' || c == 27)
+      break;
+    if ((c == KEY_BACKSPACE || c == 127) && pos > 0) {
+      query[--pos] = '\0';
+      query_changed = true;
+    } else if (c == KEY_UP) {
+      if (n)
+        selected = (selected - 1 + n) % n;
+    } else if (c == KEY_DOWN) {
+      if (n)
+        selected = (selected + 1) % n;
+    } else if (c >= ' ' && c < KEY_MIN && c != 127 &&
+               pos < (int)sizeof(query) - 1) {
+      query[pos++] = (char)c;
+      query[pos] = '\0';
+      query_changed = true;
+    }
+  }
+  if (c == '\n' && n > 0) {
+    snprintf(out, size, "%s", db.entries[results[selected]].path);
+    chosen = true;
+  }
+  frecency_free(&db);
+  for (int i = LINES - (JUMP_ROWS + 2); i < LINES; i++) {
+    move(i, 0);
+    clrtoeol();
+  }
+  refresh();
+  return chosen;
+}
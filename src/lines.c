@@ -0,0 +1,266 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lines.h"
+#include "pool.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+// Built for any x86-64 and picked at run time on CPUs that have it
+#define LINES_AVX2 __attribute__((target("avx2,popcnt")))
+#endif
+
+// Bytes of the buffer per pool chunk in lines_index
+#define CHUNK (1 << 20)
+
+static size_t count_words(const char *s, size_t len) {
+  const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+  const uint64_t nl = 0x0101010101010101ULL * '\n';
+  size_t n = 0, i = 0;
+  for (; len - i >= 8; i += 8) {
+    uint64_t w;
+    memcpy(&w, s + i, 8);
+    uint64_t x = w ^ nl;
+    // The high bit is set in exactly the bytes of x that are zero
+    n += __builtin_popcountll(~(((x & low7) + low7) | x | low7));
+  }
+  for (; i < len; i++)
+    n += s[i] == '\n';
+  return n;
+}
+
+// From the bottom bit up, where the nth set bit of mask is
+static size_t nth_bit(uint64_t mask, size_t n) {
+  while (--n)
+    mask &= mask - 1;
+  return (size_t)__builtin_ctzll(mask);
+}
+
+static size_t skip_bytes(const char *s, size_t len, size_t *n) {
+  const char *p = s, *end = s + len;
+  while (*n && (p = memchr(p, '\n', end - p))) {
+    p++;
+    --*n;
+  }
+  return *n ? len : (size_t)(p - s);
+}
+
+#ifdef __SSE2__
+// Matches add up in byte lanes, 255 vectors at most, before they are summed
+// into 64-bit ones
+static size_t count_sse2(const char *s, size_t len) {
+  const __m128i nl = _mm_set1_epi8('\n'), zero = _mm_setzero_si128();
+  __m128i total = zero;
+  size_t i = 0;
+  while (len - i >= 16) {
+    size_t end = len - i > 255 * 16 ? i + 255 * 16 : len;
+    __m128i acc = zero;
+    for (; end - i >= 16; i += 16)
+      acc = _mm_sub_epi8(
+          acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(s + i)), nl));
+    total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, total);
+  return lanes[0] + lanes[1] + count_words(s + i, len - i);
+}
+
+static uint64_t mask_sse2(const char *s, __m128i nl) {
+  uint64_t mask = 0;
+  for (int k = 0; k < 4; k++)
+    mask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(s + 16 * k)), nl))
+            << (16 * k);
+  return mask;
+}
+
+static size_t skip_sse2(const char *s, size_t len, size_t *n) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t i = 0;
+  for (; *n && len - i >= 64; i += 64) {
+    uint64_t mask = mask_sse2(s + i, nl);
+    size_t k = (size_t)__builtin_popcountll(mask);
+    if (k >= *n) {
+      size_t at = i + nth_bit(mask, *n) + 1;
+      *n = 0;
+      return at;
+    }
+    *n -= k;
+  }
+  return *n ? i + skip_bytes(s + i, len - i, n) : i;
+}
+#endif
+
+#ifdef LINES_AVX2
+LINES_AVX2 static size_t count_avx2(const char *s, size_t len) {
+  const __m256i nl = _mm256_set1_epi8('\n'), zero = _mm256_setzero_si256();
+  __m256i total = zero;
+  size_t i = 0;
+  while (len - i >= 32) {
+    size_t end = len - i > 255 * 32 ? i + 255 * 32 : len;
+    __m256i acc = zero;
+    for (; end - i >= 32; i += 32)
+      acc = _mm256_sub_epi8(
+          acc, _mm256_cmpeq_epi8(
+                   _mm256_loadu_si256((const __m256i *)(s + i)), nl));
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         count_words(s + i, len - i);
+}
+
+LINES_AVX2 static size_t skip_avx2(const char *s, size_t len, size_t *n) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t i = 0;
+  for (; *n && len - i >= 64; i += 64) {
+    uint64_t lo = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *)(s + i)), nl));
+    uint64_t hi = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i *)(s + i + 32)), nl));
+    uint64_t mask = lo | hi << 32;
+    size_t k = (size_t)__builtin_popcountll(mask);
+    if (k >= *n) {
+      size_t at = i + nth_bit(mask, *n) + 1;
+      *n = 0;
+      return at;
+    }
+    *n -= k;
+  }
+  return *n ? i + skip_bytes(s + i, len - i, n) : i;
+}
+#endif
+
+size_t lines_count(const char *s, size_t len) {
+#ifdef LINES_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return count_avx2(s, len);
+#endif
+#ifdef __SSE2__
+  return count_sse2(s, len);
+#else
+  return count_words(s, len);
+#endif
+}
+
+size_t lines_skip(const char *s, size_t len, size_t *n) {
+  if (!*n)
+    return 0;
+#ifdef LINES_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return skip_avx2(s, len, n);
+#endif
+#ifdef __SSE2__
+  return skip_sse2(s, len, n);
+#else
+  return skip_bytes(s, len, n);
+#endif
+}
+
+typedef struct index_job {
+  const char *buf;
+  size_t from, to, every, per_chunk;
+  // Per chunk: its newlines, and its marks numbered from its first line
+  size_t *counts, *n_found;
+  line_mark *found;
+} index_job;
+
+static void index_chunk(void *arg, int chunk, int worker) {
+  index_job *job = arg;
+  size_t from = job->from + (size_t)chunk * CHUNK;
+  size_t len = job->to - from < CHUNK ? job->to - from : CHUNK;
+  line_mark *out = job->found + chunk * job->per_chunk;
+  size_t pos = 0, lines = 0, k = 0, left;
+  (void)worker;
+  for (;;) {
+    left = job->every;
+    pos += lines_skip(job->buf + from + pos, len - pos, &left);
+    lines += job->every - left;
+    if (left)
+      break;
+    out[k].offset = from + pos;
+    out[k++].line = lines;
+  }
+  job->counts[chunk] = lines;
+  job->n_found[chunk] = k;
+}
+
+// Appends each chunk's marks, numbered on from first_line; false if the
+// marks cannot grow
+static bool merge_marks(const index_job *job, int n_chunks, size_t first_line,
+                        line_mark **marks, size_t *n_marks,
+                        size_t *cap_marks) {
+  size_t need = *n_marks;
+  for (int c = 0; c < n_chunks; c++)
+    need += job->n_found[c];
+  if (need > *cap_marks) {
+    size_t cap = *cap_marks ? *cap_marks : 1024;
+    while (cap < need)
+      cap *= 2;
+    line_mark *grown = realloc(*marks, cap * sizeof(*grown));
+    if (!grown)
+      return false;
+    *marks = grown;
+    *cap_marks = cap;
+  }
+  for (int c = 0; c < n_chunks; c++) {
+    const line_mark *m = job->found + c * job->per_chunk;
+    for (size_t i = 0; i < job->n_found[c]; i++) {
+      (*marks)[*n_marks].offset = m[i].offset;
+      (*marks)[(*n_marks)++].line = first_line + m[i].line;
+    }
+    first_line += job->counts[c];
+  }
+  return true;
+}
+
+size_t lines_index(const char *buf, size_t from, size_t to, size_t first_line,
+                   size_t every, line_mark **marks, size_t *n_marks,
+                   size_t *cap_marks) {
+  if (to <= from)
+    return 0;
+  size_t len = to - from;
+  int n_chunks = (int)((len + CHUNK - 1) / CHUNK);
+  index_job job = {buf, from, to, every ? every : 1, 0, NULL, NULL, NULL};
+  job.per_chunk = (len < CHUNK ? len : CHUNK) / job.every + 1;
+  job.counts = malloc(2 * n_chunks * sizeof(*job.counts));
+  job.found = malloc(n_chunks * job.per_chunk * sizeof(*job.found));
+  size_t total = (size_t)-1;
+  if (job.counts && job.found) {
+    job.n_found = job.counts + n_chunks;
+    if (n_chunks == 1)
+      index_chunk(&job, 0, 0);
+    else
+      pool_run(n_chunks, index_chunk, &job);
+    if (merge_marks(&job, n_chunks, first_line, marks, n_marks, cap_marks)) {
+      total = 0;
+      for (int c = 0; c < n_chunks; c++)
+        total += job.counts[c];
+    }
+  }
+  free(job.counts);
+  free(job.found);
+  return total;
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+
+// Newline kernels for indexing large texts: 32 bytes at a time with AVX2
+// where the CPU has it, 16 with SSE2, and eight bytes to a word otherwise.
+
+// Where a line starts, and its number counting from 0
+typedef struct line_mark {
+  size_t offset, line;
+} line_mark;
+
+size_t lines_count(const char *, size_t);
+// Offset just past the nth newline (n from 1) in the buffer; the buffer's
+// length when it holds fewer, with *n lowered by those it does
+size_t lines_skip(const char *, size_t, size_t *);
+
+// Counts the newlines in bytes [from, to) of a buffer over the worker pool
+// and returns how many there are. Each chunk of the range appends every
+// `every`th line start it holds to *marks, numbered on from first_line, the
+// number of the line at from, so neighbouring marks are fewer than
+// 2 * every lines apart. Returns (size_t)-1, with the marks unchanged, if
+// they cannot grow.
+size_t lines_index(const char *, size_t from, size_t to, size_t first_line,
+                   size_t every, line_mark **marks, size_t *n_marks,
+                   size_t *cap_marks);
+
+#endif
@@ -15,8 +15,19 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with fex.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include "fileops.h"
+#include "find.h"
+#include "frecency.h"
+#include "jump.h"
+#include "opener.h"
+#include "pick.h"
 #include "platform.h"
+#include "replay.h"
+#include "server.h"
+#include "timing.h"
 #include "trie.h"
+#include "view.h"
+#include <locale.h>
 #include <ncurses.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -28,20 +39,40 @@ static int startx = 0, starty = 0;
 static char **choices = NULL;
 static int n_choices;
 static bool show_hidden_files = false;
+// Set when the listing came sorted from the server
+static bool choices_sorted;
+// Shown instead of the description until the next key
+static const char *notice;
+static search_index search_idx;
+// Where the final directory goes when the wrapper asked for a handoff
+static FILE *handoff;
+// Absolute paths of the entries marked with Space, and of those taken with
+// y or x for the next p
+static char **marked, **clipboard;
+static int n_marked, n_clipboard;
+static bool clipboard_move;
 static void free_cbuf(void);
 static void load_directory(const char *);
 static WINDOW *recreate_menu_window(void);
 
-static void handle_exit(int status) {
+// Set by SIGINT while a copy runs; the main loop waits for it, then exits
+static volatile sig_atomic_t interrupted;
+
+// Restores the terminal and hands the directory off; the part of the exit
+// that never waits for the copy worker
+static void leave(int status) {
   curs_set(1);
   clear();
   refresh();
   endwin();
   free_cbuf();
-  FILE *fptr;
-  char dir[BUFSIZE];
-  snprintf(dir, sizeof(dir), "%s/.fexlastdir", getenv("HOME"));
-  fptr = fopen(dir, "w");
+  server_disconnect();
+  FILE *fptr = handoff;
+  if (!fptr) {
+    char dir[BUFSIZE];
+    snprintf(dir, sizeof(dir), "%s/.fexlastdir", getenv("HOME"));
+    fptr = fopen(dir, "we");
+  }
   if (!fptr) {
     perror("fopen");
     exit(EXIT_FAILURE);
@@ -49,12 +80,41 @@ static void handle_exit(int status) {
   char cwd[BUFSIZE];
   if (platform_current_directory(cwd, sizeof(cwd)) == 0)
     fprintf(fptr, "%s", cwd);
+  fclose(fptr);
   exit(status);
 }
 
+static void handle_exit(int status) {
+  fileops_cancel();
+  leave(status);
+}
+
+// The shell wrapper can take the final directory on an inherited
+// descriptor (FEX_HANDOFF_FD) or at a path of its own (FEX_HANDOFF_PATH)
+// instead of ~/.fexlastdir, which costs no disk write when it is a pipe and
+// keeps concurrent sessions apart. The descriptor is kept from children, so
+// a program opened from fex cannot hold the wrapper's pipe open.
+static void open_handoff(void) {
+  const char *fd_env = getenv("FEX_HANDOFF_FD");
+  const char *path_env = getenv("FEX_HANDOFF_PATH");
+  if (fd_env && *fd_env) {
+    char *end;
+    long fd = strtol(fd_env, &end, 10);
+    if (*end == '\0' && fd > 2 && fd < 1024 && (handoff = fdopen(fd, "w")))
+      platform_set_cloexec((int)fd);
+  } else if (path_env && *path_env)
+    handoff = fopen(path_env, "we");
+}
+
+// Joining the worker here could deadlock on its lock, so a copy in flight
+// is only told to stop and the main loop finishes the exit
 static void sighandler(int signum) {
-  if (signum == SIGINT)
-    handle_exit(EXIT_SUCCESS);
+  if (signum != SIGINT)
+    return;
+  if (fileops_interrupt())
+    interrupted = 1;
+  else
+    leave(EXIT_SUCCESS);
 }
 
 static int n_digits(int n) {
@@ -79,20 +139,25 @@ static int cmp_choices(const void *a, const void *b) {
   const char *sa = *(const char *const *)a;
   const char *sb = *(const char *const *)b;
 
-  if (strcmp(sa, "..") == 0)
-    return -1;
-  if (strcmp(sb, "..") == 0)
-    return +1;
+  bool da = strcmp(sa, "..") == 0, db = strcmp(sb, "..") == 0;
+  if (da || db)
+    return db - da;
   return strcmp(sa, sb);
 }
 
 static void get_file_info(const char *pathname, char *result, size_t size) {
+  char cwd[BUFSIZE];
+  long long t = replay_begin();
   if (size)
     result[0] = '\0';
-  platform_describe_file(pathname, result, size);
+  if (platform_current_directory(cwd, sizeof(cwd)) != 0 ||
+      server_describe(cwd, pathname, result, size) != 0)
+    platform_describe_file(pathname, result, size);
+  replay_end(REPLAY_DESCRIBE, t);
 }
 
 static void free_cbuf(void) {
+  search_index_free(&search_idx);
   for (int i = 0; i < n_choices; i++)
     free(choices[i]);
   free(choices);
@@ -111,7 +176,76 @@ static WINDOW *recreate_menu_window(void) {
   return menu_win;
 }
 
+// Index in marked of dir/name, or -1
+static int find_mark(const char *dir, const char *name) {
+  size_t len = strlen(dir);
+  if (len && dir[len - 1] == '/')
+    len--;
+  for (int i = 0; i < n_marked; i++)
+    if (strncmp(marked[i], dir, len) == 0 && marked[i][len] == '/' &&
+        strcmp(marked[i] + len + 1, name) == 0)
+      return i;
+  return -1;
+}
+
+static void toggle_mark(const char *name) {
+  char cwd[BUFSIZE], path[2 * BUFSIZE];
+  if (strcmp(name, "..") == 0 ||
+      platform_current_directory(cwd, sizeof(cwd)) != 0)
+    return;
+  int i = find_mark(cwd, name);
+  if (i >= 0) {
+    free(marked[i]);
+    marked[i] = marked[--n_marked];
+    return;
+  }
+  char **grown = realloc(marked, (n_marked + 1) * sizeof(*marked));
+  if (!grown)
+    return;
+  marked = grown;
+  snprintf(path, sizeof(path), "%s%s%s", cwd,
+           cwd[strlen(cwd) - 1] == '/' ? "" : "/", name);
+  if ((marked[n_marked] = strdup(path)))
+    n_marked++;
+}
+
+static void clear_clipboard(void) {
+  for (int i = 0; i < n_clipboard; i++)
+    free(clipboard[i]);
+  free(clipboard);
+  clipboard = NULL;
+  n_clipboard = 0;
+}
+
+// y and x: the marked entries, or else the highlighted one, are what the
+// next p copies or moves
+static void take_entries(const char *name, bool move) {
+  if (!n_marked)
+    toggle_mark(name);
+  if (!n_marked)
+    return;
+  clear_clipboard();
+  clipboard = marked;
+  n_clipboard = n_marked;
+  clipboard_move = move;
+  marked = NULL;
+  n_marked = 0;
+  notice = move ? "To move; p moves here" : "To copy; p copies here";
+}
+
+static void paste_entries(void) {
+  char cwd[BUFSIZE];
+  if (!n_clipboard)
+    notice = "Nothing to paste; mark with Space, then y or x";
+  else if (platform_current_directory(cwd, sizeof(cwd)) != 0 ||
+           !fileops_start(clipboard_move, clipboard, n_clipboard, cwd))
+    notice = "Cannot start; is a copy still running?";
+  else if (clipboard_move)
+    clear_clipboard();
+}
+
 static void print_menu(WINDOW *menu_win, int highlight) {
+  long long t = replay_begin();
   int x = 2, y = 2, maxy = getmaxy(menu_win), visible_count = maxy - 2, first;
   if (n_choices <= visible_count)
     first = 0;
@@ -121,26 +255,31 @@ static void print_menu(WINDOW *menu_win, int highlight) {
       first = n_choices - visible_count + 1;
   }
   werase(menu_win);
+  char cwd[BUFSIZE] = "";
+  if (n_marked)
+    platform_current_directory(cwd, sizeof(cwd));
   for (int i = first; i < first + visible_count && i < n_choices; i++) {
     PlatformFileKind kind = platform_file_kind(choices[i]);
     if ((highlight - 1) == i)
       wattron(menu_win, A_REVERSE);
 
+    mvwprintw(menu_win, y, x, "%d\t|%c", i,
+              *cwd && find_mark(cwd, choices[i]) >= 0 ? '*' : ' ');
     switch (kind) {
     case PLATFORM_FILE_SYMLINK:
-      mvwprintw(menu_win, y, x, "%d\t| {%s}", i, choices[i]);
+      wprintw(menu_win, "{%s}", choices[i]);
       break;
     case PLATFORM_FILE_DIRECTORY:
-      mvwprintw(menu_win, y, x, "%d\t| [%s]", i, choices[i]);
+      wprintw(menu_win, "[%s]", choices[i]);
       break;
     case PLATFORM_FILE_CHAR_DEVICE:
-      mvwprintw(menu_win, y, x, "%d\t| ..%s..", i, choices[i]);
+      wprintw(menu_win, "..%s..", choices[i]);
       break;
     case PLATFORM_FILE_BLOCK_DEVICE:
-      mvwprintw(menu_win, y, x, "%d\t| _%s_", i, choices[i]);
+      wprintw(menu_win, "_%s_", choices[i]);
       break;
     default:
-      mvwprintw(menu_win, y, x, "%d\t| %s", i, choices[i]);
+      wprintw(menu_win, "%s", choices[i]);
       break;
     }
 
@@ -149,6 +288,7 @@ static void print_menu(WINDOW *menu_win, int highlight) {
     y++;
   }
   wrefresh(menu_win);
+  replay_end(REPLAY_RENDER, t);
 }
 
 static void print_logo(WINDOW *menu_win) {
@@ -183,6 +323,25 @@ static void print_logo(WINDOW *menu_win) {
   wgetch(menu_win);
 }
 
+// Runs $VISUAL, else $EDITOR, else vim, on path. The variable may carry
+// arguments ("emacs -nw"); they are split on blanks, with no shell.
+static int edit_file(const char *path) {
+  const char *editor = getenv("VISUAL");
+  char words[BUFSIZE], *argv[32];
+  int argc = 0;
+  if (!editor || !*editor)
+    editor = getenv("EDITOR");
+  snprintf(words, sizeof(words), "%s", editor && *editor ? editor : "vim");
+  for (char *w = strtok(words, " \t"); w && argc < 30;
+       w = strtok(NULL, " \t"))
+    argv[argc++] = w;
+  if (!argc)
+    return -1;
+  argv[argc++] = (char *)path;
+  argv[argc] = NULL;
+  return platform_spawn_and_wait(argv);
+}
+
 static void handle_keyw(WINDOW *menu_win, int n_c, int *highlight) {
   mvprintw(LINES - 1, 0, ": ");
   int c = 0, count = 0, max_digits_val = n_digits(n_c), i = 0;
@@ -218,15 +377,15 @@ static void handle_keyw(WINDOW *menu_win, int n_c, int *highlight) {
       else if (strncmp(input_buffer, "gg", 3) == 0)
         *highlight = 1;
       else if (strncmp(input_buffer, "vim", 3) == 0) {
-        char *argv_local[] = {"vim", NULL, NULL};
-        argv_local[1] =
-            (input_buffer[3] == '!') ? "." : choices[*highlight - 1];
+        // The same editor as Enter on a text file, vim only as the fallback
         endwin();
-        if (platform_spawn_and_wait(argv_local) == -1)
-          handle_exit(EXIT_FAILURE);
+        int status =
+            edit_file(input_buffer[3] == '!' ? "." : choices[*highlight - 1]);
         menu_win = recreate_menu_window();
         load_directory(".");
         print_menu(menu_win, *highlight);
+        if (status == -1)
+          notice = "Cannot run the editor";
         refresh();
         break;
       } else if (strncmp(input_buffer, "w", 2) == 0) {
@@ -239,24 +398,125 @@ static void handle_keyw(WINDOW *menu_win, int n_c, int *highlight) {
   refresh();
 }
 
-void load_directory(const char *dirpath) {
-  if (platform_change_directory(dirpath) != 0) {
-    perror("chdir");
-    return;
+typedef struct name_list {
+  char **names;
+  int count, cap;
+} name_list;
+
+static int collect_name(const PlatformEntry *e, void *arg) {
+  name_list *l = arg;
+  // Grow geometrically: large directories would otherwise spend most of the
+  // listing in realloc
+  if (l->count == l->cap) {
+    int cap = l->cap ? l->cap * 2 : 64;
+    char **tmp = realloc(l->names, cap * sizeof(*tmp));
+    if (!tmp)
+      return -1;
+    l->names = tmp;
+    l->cap = cap;
   }
-  free_cbuf();
+  if (!(l->names[l->count] = strdup(e->name)))
+    return -1;
+  l->count++;
+  return 0;
+}
 
-  if (platform_list_directory(show_hidden_files, &choices, &n_choices) != 0) {
+static void list_choices(void) {
+  char cwd[BUFSIZE];
+  free_cbuf();
+  choices_sorted =
+      platform_current_directory(cwd, sizeof(cwd)) == 0 &&
+      server_list(cwd, show_hidden_files, &choices, &n_choices) == 0;
+  if (choices_sorted)
+    return;
+  name_list l = {0};
+  if (platform_stream_directory(".", show_hidden_files, false, collect_name,
+                                &l) != 0) {
+    for (int i = 0; i < l.count; i++)
+      free(l.names[i]);
+    free(l.names);
     perror("opendir");
     exit(EXIT_FAILURE);
   }
+  choices = l.names;
+  n_choices = l.count;
+}
+
+// Moves the k smallest choices to the front, in order, and leaves the rest
+// unsorted behind them: enough to paint the first screen of a large
+// directory before sorting all of it.
+static void sort_first_choices(int k) {
+  if (choices_sorted)
+    return;
+  if (k >= n_choices) {
+    qsort(choices, n_choices, sizeof(*choices), cmp_choices);
+    return;
+  }
+  int lo = 0, hi = n_choices - 1;
+  while (lo < hi) {
+    char *pivot = choices[lo + (hi - lo) / 2], *tmp;
+    int i = lo, j = hi;
+    while (i <= j) {
+      while (cmp_choices(&choices[i], &pivot) < 0)
+        i++;
+      while (cmp_choices(&choices[j], &pivot) > 0)
+        j--;
+      if (i <= j) {
+        tmp = choices[i];
+        choices[i++] = choices[j];
+        choices[j--] = tmp;
+      }
+    }
+    if (k - 1 <= j)
+      hi = j;
+    else if (k - 1 >= i)
+      lo = i;
+    else
+      break;
+  }
+  qsort(choices, k, sizeof(*choices), cmp_choices);
+}
+
+// A reload of the directory already shown, after a copy or toggling hidden
+// entries, is not another visit
+static void record_visit(void) {
+  static char last[BUFSIZE];
+  char cwd[BUFSIZE];
+  if (platform_current_directory(cwd, sizeof(cwd)) == 0 &&
+      strcmp(cwd, last) != 0) {
+    frecency_visit(cwd);
+    snprintf(last, sizeof(last), "%s", cwd);
+  }
+}
+
+void load_directory(const char *dirpath) {
+  long long t = replay_begin();
+  if (platform_change_directory(dirpath) != 0) {
+    perror("chdir");
+    replay_end(REPLAY_LOAD, t);
+    return;
+  }
+  list_choices();
   // Sort with our custom comparator
-  qsort(choices, n_choices, sizeof(*choices), cmp_choices);
+  if (!choices_sorted)
+    qsort(choices, n_choices, sizeof(*choices), cmp_choices);
+  record_visit();
+  replay_end(REPLAY_LOAD, t);
 }
 
-static void error(const char *what) {
-  fprintf(stderr, "%s\n", what);
-  handle_exit(EXIT_FAILURE);
+// Opens the directory holding path and moves the highlight onto it.
+static void reveal_path(const char *path, int *highlight) {
+  char dir[BUFSIZE];
+  const char *slash = strrchr(path, '/'), *name = slash ? slash + 1 : path;
+  snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - path) : 1,
+           slash ? path : ".");
+  load_directory(dir);
+  *highlight = 1;
+  for (int i = 0; i < n_choices; i++)
+    if (strcmp(choices[i], name) == 0) {
+      *highlight = i + 1;
+      break;
+    }
 }
 
 static void print_licensing(WINDOW *menu_win) {
@@ -267,20 +527,185 @@ static void print_licensing(WINDOW *menu_win) {
   wrefresh(menu_win);
 }
 
+enum list_format { LIST_TEXT, LIST_NULL, LIST_JSON };
+
+typedef struct entry_list {
+  PlatformEntry *entries;
+  size_t count, cap;
+} entry_list;
+
+static const char *kind_name(PlatformFileKind kind) {
+  switch (kind) {
+  case PLATFORM_FILE_REGULAR:
+    return "file";
+  case PLATFORM_FILE_DIRECTORY:
+    return "dir";
+  case PLATFORM_FILE_SYMLINK:
+    return "link";
+  case PLATFORM_FILE_CHAR_DEVICE:
+    return "char";
+  case PLATFORM_FILE_BLOCK_DEVICE:
+    return "block";
+  default:
+    return "unknown";
+  }
+}
+
+static void print_json_string(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+  }
+  putchar('"');
+}
+
+// A line per entry, kind, size, mtime and name separated by tabs, or the
+// same record NUL-terminated, or a JSON object per line. ".." is left out.
+static int print_entry(const PlatformEntry *e, void *arg) {
+  enum list_format format = *(const enum list_format *)arg;
+  if (strcmp(e->name, "..") == 0)
+    return 0;
+  if (format == LIST_JSON) {
+    fputs("{\"name\":", stdout);
+    print_json_string(e->name);
+    printf(",\"kind\":\"%s\",\"size\":%lld,\"mtime\":%lld}\n",
+           kind_name(e->kind), e->size, e->mtime);
+  } else
+    printf("%s\t%lld\t%lld\t%s%c", kind_name(e->kind), e->size, e->mtime,
+           e->name, format == LIST_NULL ? '\0' : '\n');
+  return ferror(stdout) ? -1 : 0;
+}
+
+static int collect_entry(const PlatformEntry *e, void *arg) {
+  entry_list *l = arg;
+  if (l->count == l->cap) {
+    size_t cap = l->cap ? l->cap * 2 : 64;
+    PlatformEntry *tmp = realloc(l->entries, cap * sizeof(*tmp));
+    if (!tmp)
+      return -1;
+    l->entries = tmp;
+    l->cap = cap;
+  }
+  l->entries[l->count] = *e;
+  if (!(l->entries[l->count].name = strdup(e->name)))
+    return -1;
+  l->count++;
+  return 0;
+}
+
+static int cmp_entries(const void *a, const void *b) {
+  return cmp_choices(&((const PlatformEntry *)a)->name,
+                     &((const PlatformEntry *)b)->name);
+}
+
+// Lists dir for scripts with the browser's hidden rule. Entries are written
+// as they are read, so memory stays flat however large the directory is;
+// sorting them as the browser does means holding the whole listing first.
+static int list_headless(const char *dir, enum list_format format,
+                         bool sorted) {
+  static char buf[1 << 16];
+  setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+  int ret;
+  if (!sorted)
+    ret = platform_stream_directory(dir, show_hidden_files, true, print_entry,
+                                    &format);
+  else {
+    entry_list l = {0};
+    ret = platform_stream_directory(dir, show_hidden_files, true,
+                                    collect_entry, &l);
+    if (!ret)
+      qsort(l.entries, l.count, sizeof(*l.entries), cmp_entries);
+    for (size_t i = 0; !ret && i < l.count; i++)
+      ret = print_entry(&l.entries[i], &format);
+    for (size_t i = 0; i < l.count; i++)
+      free((char *)l.entries[i].name);
+    free(l.entries);
+  }
+  if (fflush(stdout) != 0 || ret != 0) {
+    perror(dir);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static void usage(FILE *out) {
+  fprintf(out, "usage: fex_exec [--bench-startup | --replay SCRIPT] [DIR]\n"
+               "       fex_exec --list [--json|--null] [--all] [--sort] [DIR]\n"
+               "       fex_exec --pick [--null]\n"
+               "       fex_exec --server\n");
+}
+
 int main(int argc, char **argv) {
+  timing_log startup = {0}, *marks = NULL;
+  timing_mark(&startup, "main");
+  const char *start_dir = ".", *replay_script = NULL;
+  bool list = false, list_sorted = false, pick = false;
+  enum list_format format = LIST_TEXT;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench-startup") == 0)
+      marks = &startup;
+    else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+      replay_script = argv[++i];
+    else if (strcmp(argv[i], "--server") == 0)
+      return server_run();
+    else if (strcmp(argv[i], "--list") == 0)
+      list = true;
+    else if (strcmp(argv[i], "--pick") == 0)
+      pick = true;
+    else if (strcmp(argv[i], "--json") == 0)
+      format = LIST_JSON;
+    else if (strcmp(argv[i], "--null") == 0)
+      format = LIST_NULL;
+    else if (strcmp(argv[i], "--all") == 0)
+      show_hidden_files = true;
+    else if (strcmp(argv[i], "--sort") == 0)
+      list_sorted = true;
+    else if (strcmp(argv[i], "--help") == 0) {
+      usage(stdout);
+      return EXIT_SUCCESS;
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      usage(stderr);
+      return EXIT_FAILURE;
+    } else
+      start_dir = argv[i];
+  }
+  if (list)
+    return list_headless(start_dir, format, list_sorted);
+  if (pick)
+    return pick_run(format == LIST_NULL);
+  // Before the chdir, so that a relative FEX_HANDOFF_PATH is taken from
+  // where fex was started
+  open_handoff();
+  if (!platform_is_directory(start_dir) ||
+      platform_change_directory(start_dir) != 0) {
+    fprintf(stderr, "Cannot find selected directory\n");
+    return EXIT_FAILURE;
+  }
+  setlocale(LC_ALL, "");
   signal(SIGINT, sighandler);
   WINDOW *menu_win;
   int highlight = 1, choice = 0, c;
-  char info[BUFSIZE];
-  if (argc < 2)
-    load_directory(".");
-  else {
-    if (platform_is_directory(argv[1]))
-      load_directory(argv[1]);
-    else
-      error("Cannot find selected directory");
-  }
-  initscr();
+  char info[BUFSIZE] = {0};
+  FILE *replay_in = NULL, *replay_out = NULL;
+  if (replay_script && !replay_open(replay_script, &replay_in, &replay_out))
+    return EXIT_FAILURE;
+
+  // Terminal first, then just enough of the listing to paint the first
+  // screen; everything not visible waits until after that frame
+  if (replay_in) {
+    const char *term = getenv("TERM");
+    if (!newterm(term && *term ? term : "xterm", replay_out, replay_in)) {
+      fprintf(stderr, "Cannot open a screen for the replay\n");
+      return EXIT_FAILURE;
+    }
+  } else
+    initscr();
   clear();
   noecho();
   cbreak();
@@ -289,16 +714,85 @@ int main(int argc, char **argv) {
   menu_win = newwin(LINES, COLS, starty, startx);
   keypad(menu_win, TRUE);
   curs_set(0);
+  timing_mark(marks, "initscr");
+  list_choices();
+  timing_mark(marks, "list");
+  sort_first_choices(LINES);
+  timing_mark(marks, "sort first screen");
   refresh();
   print_menu(menu_win, highlight);
+  timing_mark(marks, "first frame");
+  if (!choices_sorted && n_choices > LINES)
+    qsort(choices + LINES, n_choices - LINES, sizeof(*choices), cmp_choices);
+  timing_mark(marks, "sort rest");
+  // The first listing is read directly; the server serves the ones after
+  // it, and the openers are first needed on Enter
+  static char opener_notice[64];
+  int bad_line = opener_load();
+  if (bad_line) {
+    snprintf(opener_notice, sizeof(opener_notice),
+             "Skipped line %d of the openers file", bad_line);
+    notice = opener_notice;
+  }
+  timing_mark(marks, "openers");
+  if (!getenv("FEX_NO_SERVER"))
+    server_connect();
+  timing_mark(marks, "connect");
   print_licensing(menu_win);
   refresh();
-  while (1) {
+  timing_mark(marks, "licensing");
+  record_visit();
+  timing_mark(marks, "record visit");
+  if (marks) {
     get_file_info(choices[highlight - 1], info, sizeof(info));
-    mvprintw(0, 0, "%s", info);
-    clrtoeol();
-    refresh();
+    timing_mark(marks, "describe");
+    endwin();
+    free_cbuf();
+    timing_report(marks, stderr);
+    return EXIT_SUCCESS;
+  }
+  while (1) {
+    if (interrupted)
+      handle_exit(EXIT_SUCCESS);
+    // Describing the highlighted entry may spawn `file`, so it waits until
+    // no key is queued: holding a key scrolls without describing each entry
+    wtimeout(menu_win, 0);
     c = wgetch(menu_win);
+    wtimeout(menu_win, -1);
+    if (c == ERR) {
+      get_file_info(choices[highlight - 1], info, sizeof(info));
+      mvprintw(0, 0, "%s", notice ? notice : info);
+      notice = NULL;
+      clrtoeol();
+      refresh();
+      if (replay_in && !replay_next())
+        break;
+      // A copy in the background shows its progress a few times a second
+      // until a key comes; its outcome stays up until the next one
+      enum fileops_state ops;
+      char status[BUFSIZE];
+      while ((ops = fileops_poll(status, sizeof(status))) != FILEOPS_IDLE) {
+        mvprintw(0, 0, "%s", status);
+        clrtoeol();
+        refresh();
+        if (ops == FILEOPS_FINISHED) {
+          load_directory(".");
+          if (highlight > n_choices)
+            highlight = n_choices;
+          print_menu(menu_win, highlight);
+          break;
+        }
+        wtimeout(menu_win, 250);
+        c = wgetch(menu_win);
+        wtimeout(menu_win, -1);
+        if (interrupted)
+          handle_exit(EXIT_SUCCESS);
+        if (c != ERR)
+          break;
+      }
+      if (c == ERR)
+        c = wgetch(menu_win);
+    }
     switch (c) {
     case KEY_UP:
     case 'k':
@@ -322,20 +816,50 @@ int main(int argc, char **argv) {
         highlight = 1;
         memset(info, 0, sizeof(info));
       } else {
-        if (platform_is_text_file(choices[highlight - 1])) {
-          char *argv_local[] = {"vim", choices[highlight - 1], NULL};
+        const char *path = choices[highlight - 1];
+        char mime[128] = "";
+        // A rule for the extension decides without running `file`
+        const opener_rule *rule = opener_match(path, NULL);
+        if (!rule && platform_mime_type(path, mime, sizeof(mime)) == 0)
+          rule = opener_match(path, mime);
+        bool text = !rule && strncmp(mime, "text/", 5) == 0;
+        if (text || (rule && rule->terminal)) {
           endwin();
-          if (platform_spawn_and_wait(argv_local) == -1)
-            handle_exit(EXIT_FAILURE);
+          int status = text ? edit_file(path) : opener_run(rule, path);
           menu_win = recreate_menu_window();
           print_menu(menu_win, highlight);
+          if (status == -1)
+            notice = text ? "Cannot run the editor" : "Cannot run the opener";
           refresh();
-          break;
-        }
-        platform_open_path(choices[highlight - 1]);
+        } else if (rule) {
+          if (opener_run(rule, path) == -1)
+            notice = "Cannot run the opener";
+        } else
+          platform_open_path(path);
       }
       break;
     }
+    case ' ':
+      toggle_mark(choices[highlight - 1]);
+      highlight = (highlight == n_choices) ? 1 : highlight + 1;
+      break;
+    case 'y':
+    case 'x':
+      take_entries(choices[highlight - 1], c == 'x');
+      break;
+    case 'p':
+      paste_entries();
+      break;
+    case 'v':
+      if (!platform_is_directory(choices[highlight - 1])) {
+        int status = view_file(choices[highlight - 1]);
+        clear();
+        refresh();
+        touchwin(menu_win);
+        if (status == -1)
+          notice = "Cannot view the file";
+      }
+      break;
     case 'q':
       choice = -1;
       break;
@@ -349,9 +873,35 @@ int main(int argc, char **argv) {
     case ':':
       handle_keyw(menu_win, n_choices - 1, &highlight);
       break;
-    case '/':
-      handle_search(menu_win, &highlight, n_choices, choices);
+    case '/': {
+      long long t = replay_begin();
+      handle_search(menu_win, &highlight, n_choices, choices, &search_idx);
+      replay_end(REPLAY_SEARCH, t);
       break;
+    }
+    case 'f': {
+      char found[BUFSIZE];
+      long long t = replay_begin();
+      bool ok = handle_find(menu_win, show_hidden_files, found, sizeof(found));
+      replay_end(REPLAY_SEARCH, t);
+      if (ok) {
+        reveal_path(found, &highlight);
+        memset(info, 0, sizeof(info));
+      }
+      break;
+    }
+    case 'z': {
+      char target[BUFSIZE];
+      long long t = replay_begin();
+      bool ok = handle_jump(menu_win, target, sizeof(target));
+      replay_end(REPLAY_SEARCH, t);
+      if (ok && platform_is_directory(target)) {
+        load_directory(target);
+        highlight = 1;
+        memset(info, 0, sizeof(info));
+      }
+      break;
+    }
     case '~':
       load_directory(getenv("HOME"));
       // if our current selection is further down than the current directory
@@ -368,6 +918,13 @@ int main(int argc, char **argv) {
     if (choice)
       break;
   }
+  if (replay_in) {
+    endwin();
+    free_cbuf();
+    server_disconnect();
+    replay_report(stdout);
+    return EXIT_SUCCESS;
+  }
   handle_exit(EXIT_SUCCESS);
   return 0;
 }
@@ -0,0 +1,211 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "match.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Small enough that a cancelled query gives its threads back within a
+// fraction of a frame, large enough to keep the per-chunk merge cheap
+#define MATCH_MIN_CHUNK 2048
+#define MATCH_CHUNKS_PER_WORKER 16
+
+bool match_exec_init(match_exec *ex, int n) {
+  *ex = (match_exec){0};
+  int max_chunks = n / MATCH_MIN_CHUNK + 2;
+  ex->set = malloc((n + 1) * sizeof(*ex->set));
+  ex->scratch = malloc((n + 1) * sizeof(*ex->scratch));
+  ex->top = malloc(MATCH_TOP_K * sizeof(*ex->top));
+  ex->hits = malloc((n + 1) * sizeof(*ex->hits));
+  ex->counts = malloc(max_chunks * sizeof(*ex->counts));
+  ex->kept = malloc(max_chunks * sizeof(*ex->kept));
+  if (!ex->set || !ex->scratch || !ex->top || !ex->hits || !ex->counts ||
+      !ex->kept) {
+    match_exec_free(ex);
+    return false;
+  }
+  return true;
+}
+
+void match_exec_free(match_exec *ex) {
+  match_cancel(ex);
+  free(ex->set);
+  free(ex->scratch);
+  free(ex->top);
+  free(ex->hits);
+  free(ex->counts);
+  free(ex->kept);
+  *ex = (match_exec){0};
+}
+
+static void chunk_bounds(const match_exec *ex, int chunk, int *lo, int *hi) {
+  *lo = chunk * ex->chunk_size;
+  *hi = *lo + ex->chunk_size;
+  if (*hi > ex->n_input)
+    *hi = ex->n_input;
+}
+
+static void fuzzy_chunk(void *p, int chunk, int worker) {
+  match_exec *ex = p;
+  int lo, hi, k;
+  (void)worker;
+  ex->counts[chunk] = ex->kept[chunk] = 0;
+  if (__atomic_load_n(&ex->cancelled, __ATOMIC_RELAXED))
+    return;
+  chunk_bounds(ex, chunk, &lo, &hi);
+  if (ex->refine)
+    k = fuzzy_filter(&ex->pat, ex->names, ex->folded, ex->n_names,
+                     ex->set + lo, hi - lo, ex->set + lo);
+  else {
+    k = fuzzy_filter(&ex->pat, ex->names + lo,
+                     ex->folded ? ex->folded + lo : NULL, hi - lo, NULL, 0,
+                     ex->set + lo);
+    for (int i = 0; i < k; i++)
+      ex->set[lo + i].index += lo;
+  }
+  // Rank this chunk's matches; only its best MATCH_TOP_K reach the merge
+  memcpy(ex->scratch + lo, ex->set + lo, k * sizeof(*ex->scratch));
+  fuzzy_sort(ex->scratch + lo, k);
+  ex->counts[chunk] = k;
+  ex->kept[chunk] = k < MATCH_TOP_K ? k : MATCH_TOP_K;
+}
+
+static void regex_chunk(void *p, int chunk, int worker) {
+  match_exec *ex = p;
+  int lo, hi;
+  ex->counts[chunk] = 0;
+  if (__atomic_load_n(&ex->cancelled, __ATOMIC_RELAXED))
+    return;
+  chunk_bounds(ex, chunk, &lo, &hi);
+  ex->counts[chunk] =
+      regex_match_range(ex->regex, worker, ex->names, lo, hi, ex->hits + lo);
+}
+
+static void submit(match_exec *ex, int n_input, pool_fn fn) {
+  ex->n_input = n_input;
+  ex->chunk_size = n_input / (pool_workers() * MATCH_CHUNKS_PER_WORKER);
+  if (ex->chunk_size < MATCH_MIN_CHUNK)
+    ex->chunk_size = MATCH_MIN_CHUNK;
+  ex->n_chunks = (n_input + ex->chunk_size - 1) / ex->chunk_size;
+  ex->cancelled = 0;
+  ex->running = true;
+  // A single chunk is cheaper done here than handed to a thread
+  if (ex->n_chunks == 1)
+    fn(ex, 0, 0);
+  else
+    pool_start(ex->n_chunks, fn, ex);
+}
+
+// Scores names against pat, or only the previous fuzzy matches when refine
+// is set and the query merely grew since.
+void match_fuzzy(match_exec *ex, char *const names[], char *const folded[],
+                 int n, const fuzzy_pattern *pat, bool refine) {
+  match_cancel(ex);
+  ex->names = names;
+  ex->folded = folded;
+  ex->n_names = n;
+  ex->pat = *pat;
+  ex->regex = NULL;
+  ex->refine = refine && ex->set_valid;
+  ex->set_valid = false;
+  submit(ex, ex->refine ? ex->n_set : n, fuzzy_chunk);
+}
+
+void match_regex(match_exec *ex, char *const names[], int n,
+                 regex_entry *regex) {
+  match_cancel(ex);
+  ex->names = names;
+  ex->folded = NULL;
+  ex->n_names = n;
+  ex->regex = regex;
+  submit(ex, n, regex_chunk);
+}
+
+// Joins the chunks' results: every chunk wrote its matches at the start of
+// its own range, so the gaps are closed, and the ranked heads of the fuzzy
+// chunks are merged into top.
+static void merge(match_exec *ex) {
+  int total = 0;
+  if (ex->regex) {
+    for (int c = 0; c < ex->n_chunks; c++) {
+      memmove(ex->hits + total, ex->hits + c * ex->chunk_size,
+              ex->counts[c] * sizeof(*ex->hits));
+      total += ex->counts[c];
+    }
+    ex->n_hits = total;
+    return;
+  }
+  for (int c = 0; c < ex->n_chunks; c++) {
+    memmove(ex->set + total, ex->set + c * ex->chunk_size,
+            ex->counts[c] * sizeof(*ex->set));
+    total += ex->counts[c];
+    ex->counts[c] = 0; // from here on, how far the merge got in chunk c
+  }
+  ex->n_set = total;
+  ex->set_valid = true;
+  for (ex->n_top = 0; ex->n_top < MATCH_TOP_K; ex->n_top++) {
+    const fuzzy_result *best = NULL;
+    int from = -1;
+    for (int c = 0; c < ex->n_chunks; c++) {
+      if (ex->counts[c] == ex->kept[c])
+        continue;
+      const fuzzy_result *r = ex->scratch + c * ex->chunk_size + ex->counts[c];
+      if (!best || fuzzy_compare(r, best) < 0) {
+        best = r;
+        from = c;
+      }
+    }
+    if (!best)
+      break;
+    ex->top[ex->n_top] = *best;
+    ex->counts[from]++;
+  }
+}
+
+// Reports whether the query in flight is done, merging its results when it
+// just finished.
+bool match_poll(match_exec *ex) {
+  if (!ex->running)
+    return true;
+  if (ex->n_chunks > 1 && !pool_idle())
+    return false;
+  ex->running = false;
+  merge(ex);
+  return true;
+}
+
+void match_wait(match_exec *ex) {
+  if (ex->running && ex->n_chunks > 1)
+    pool_wait();
+  match_poll(ex);
+}
+
+// Stops the query in flight, waiting for chunks already started. Its results
+// are dropped; a cancelled fuzzy query leaves nothing to refine from.
+void match_cancel(match_exec *ex) {
+  if (!ex->running)
+    return;
+  __atomic_store_n(&ex->cancelled, 1, __ATOMIC_RELAXED);
+  if (ex->n_chunks > 1)
+    pool_wait();
+  ex->running = false;
+  if (ex->regex)
+    ex->n_hits = 0;
+  else
+    ex->n_set = ex->n_top = 0;
+}
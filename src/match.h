@@ -0,0 +1,59 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "filter.h"
+#include "fuzzy.h"
+#include <stdbool.h>
+
+#define MATCH_TOP_K 1000
+
+// Matching executor for the scanning search modes. A query is split in
+// chunks over the candidate table and run on the pool while the caller
+// keeps reading keys, so the next keystroke can cancel it. Buffers are kept
+// across queries and sized for the table passed to match_exec_init.
+//
+// Fuzzy queries leave every match in set, in candidate order (a query that
+// grew can be refined from it, unless it was cancelled), and the best
+// MATCH_TOP_K of them ranked in top. Regex queries leave their matches in
+// hits, in candidate order.
+typedef struct match_exec {
+  fuzzy_result *set, *scratch, *top;
+  int *hits, *counts, *kept;
+  int n_set, n_top, n_hits;
+
+  // The query in flight
+  char *const *names, *const *folded;
+  int n_names, n_input, chunk_size, n_chunks;
+  fuzzy_pattern pat;
+  regex_entry *regex;
+  bool refine, running, set_valid;
+  int cancelled;
+} match_exec;
+
+bool match_exec_init(match_exec *, int);
+void match_exec_free(match_exec *);
+void match_fuzzy(match_exec *, char *const[], char *const[], int,
+                 const fuzzy_pattern *, bool);
+void match_regex(match_exec *, char *const[], int, regex_entry *);
+bool match_poll(match_exec *);
+void match_wait(match_exec *);
+void match_cancel(match_exec *);
+
+#endif
@@ -0,0 +1,240 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "opener.h"
+#include "platform.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_WORDS 32
+#define MAX_KEY 64
+
+// Keys (".pdf", "image/png") hashed into an open-addressed table of rule
+// indices; keys and command words point into the config text
+static struct slot {
+  const char *key;
+  int rule;
+} *table;
+static size_t table_mask;
+static opener_rule *rules;
+static int n_rules;
+static char *text;
+
+static uint32_t hash_key(const char *key) {
+  uint32_t h = 2166136261u;
+  for (; *key; key++)
+    h = (h ^ (unsigned char)*key) * 16777619u;
+  return h;
+}
+
+static int lookup(const char *key) {
+  if (!table)
+    return -1;
+  for (size_t i = hash_key(key) & table_mask; table[i].key;
+       i = (i + 1) & table_mask)
+    if (strcmp(table[i].key, key) == 0)
+      return table[i].rule;
+  return -1;
+}
+
+// Later lines win over earlier ones for the same key
+static void insert(const char *key, int rule) {
+  size_t i = hash_key(key) & table_mask;
+  while (table[i].key && strcmp(table[i].key, key) != 0)
+    i = (i + 1) & table_mask;
+  table[i].key = key;
+  table[i].rule = rule;
+}
+
+static void lower(char *s) {
+  for (; *s; s++)
+    *s = (char)tolower((unsigned char)*s);
+}
+
+static bool valid_key(const char *key) {
+  if (strlen(key) >= MAX_KEY)
+    return false;
+  if (key[0] == '.')
+    return key[1] && !strchr(key, '/');
+  const char *slash = strchr(key, '/');
+  return slash && slash > key && slash[1];
+}
+
+static char *read_config(void) {
+  const char *config = getenv("XDG_CONFIG_HOME"), *home = getenv("HOME");
+  char path[4096];
+  if (config && *config == '/')
+    snprintf(path, sizeof(path), "%s/fex/openers", config);
+  else if (home && *home)
+    snprintf(path, sizeof(path), "%s/.config/fex/openers", home);
+  else
+    return NULL;
+  FILE *fp = fopen(path, "rbe");
+  if (!fp)
+    return NULL;
+  size_t size = 0, cap = 4096, n;
+  char *buf = malloc(cap);
+  while (buf && (n = fread(buf + size, 1, cap - size - 1, fp)) > 0) {
+    size += n;
+    if (size + 1 == cap) {
+      char *grown = realloc(buf, cap *= 2);
+      if (!grown)
+        free(buf);
+      buf = grown;
+    }
+  }
+  fclose(fp);
+  if (buf)
+    buf[size] = '\0';
+  return buf;
+}
+
+// Parses the config into rules and fills the table. Lines that do not parse
+// are skipped, and the first of them is returned (0 when all parsed).
+int opener_load(void) {
+  int bad = 0;
+  if (!(text = read_config()))
+    return 0;
+  int n_lines = 1, n_keys = 0;
+  for (const char *p = text; *p; p++)
+    n_lines += *p == '\n';
+  rules = calloc(n_lines, sizeof(*rules));
+  char **keys = malloc(n_lines * MAX_WORDS * sizeof(*keys));
+  int *key_rule = malloc(n_lines * MAX_WORDS * sizeof(*key_rule));
+  if (!rules || !keys || !key_rule) {
+    free(keys);
+    free(key_rule);
+    return 0;
+  }
+  char *next = text;
+  for (int line = 1; next; line++) {
+    char *s = next;
+    if ((next = strchr(s, '\n')))
+      *next++ = '\0';
+    s += strspn(s, " \t\r");
+    if (!*s || *s == '#')
+      continue;
+    char *eq = strchr(s, '=');
+    if (!eq) {
+      bad = bad ? bad : line;
+      continue;
+    }
+    *eq++ = '\0';
+    opener_rule *r = &rules[n_rules];
+    eq += strspn(eq, " \t");
+    if ((r->terminal = *eq == '!'))
+      eq++;
+    r->argv = malloc((MAX_WORDS + 2) * sizeof(*r->argv));
+    char *w = strtok(eq, " \t\r");
+    for (; r->argv && w && r->argc < MAX_WORDS; w = strtok(NULL, " \t\r"))
+      r->argv[r->argc++] = w;
+    // A command with more words than fit is skipped, not run cut short
+    if (!r->argc || w) {
+      bad = bad ? bad : line;
+      free(r->argv);
+      memset(r, 0, sizeof(*r));
+      continue;
+    }
+    // keys holds MAX_WORDS per line; a line with more is skipped whole
+    int first_key = n_keys;
+    char *k = strtok(s, " \t");
+    for (; k && n_keys - first_key < MAX_WORDS; k = strtok(NULL, " \t")) {
+      lower(k);
+      if (valid_key(k)) {
+        keys[n_keys] = k;
+        key_rule[n_keys++] = n_rules;
+      } else
+        bad = bad ? bad : line;
+    }
+    if (k) {
+      n_keys = first_key;
+      bad = bad ? bad : line;
+    }
+    if (n_keys > first_key)
+      n_rules++;
+    else {
+      free(r->argv);
+      memset(r, 0, sizeof(*r));
+    }
+  }
+  size_t cap = 16;
+  while (cap < (size_t)n_keys * 2)
+    cap *= 2;
+  if (n_keys && (table = calloc(cap, sizeof(*table)))) {
+    table_mask = cap - 1;
+    for (int i = 0; i < n_keys; i++)
+      insert(keys[i], key_rule[i]);
+  }
+  free(keys);
+  free(key_rule);
+  return bad;
+}
+
+const opener_rule *opener_match(const char *path, const char *mime) {
+  if (!table)
+    return NULL;
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  char key[MAX_KEY];
+  // Every suffix from a dot, longest first, so ".tar.gz" can win over ".gz";
+  // a leading dot names a hidden file, not an extension
+  for (const char *dot = strchr(base + 1, '.'); dot;
+       dot = strchr(dot + 1, '.')) {
+    if (strlen(dot) >= sizeof(key))
+      continue;
+    strcpy(key, dot);
+    lower(key);
+    int rule = lookup(key);
+    if (rule >= 0)
+      return &rules[rule];
+  }
+  if (!mime || !*mime || strlen(mime) >= sizeof(key))
+    return NULL;
+  strcpy(key, mime);
+  lower(key);
+  int rule = lookup(key);
+  char *slash = strchr(key, '/');
+  if (rule < 0 && slash) {
+    strcpy(slash + 1, "*");
+    rule = lookup(key);
+  }
+  return rule >= 0 ? &rules[rule] : NULL;
+}
+
+// Starts the rule's command on path; a terminal command is waited for
+int opener_run(const opener_rule *rule, const char *path) {
+  char *argv[MAX_WORDS + 2];
+  bool placed = false;
+  for (int i = 0; i < rule->argc; i++) {
+    argv[i] = rule->argv[i];
+    if (strcmp(argv[i], "%f") == 0) {
+      argv[i] = (char *)path;
+      placed = true;
+    }
+  }
+  int argc = rule->argc;
+  if (!placed)
+    argv[argc++] = (char *)path;
+  argv[argc] = NULL;
+  if (rule->terminal)
+    return platform_spawn_and_wait(argv);
+  return platform_spawn_detached(argv);
+}
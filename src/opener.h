@@ -0,0 +1,47 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENER_H
+#define OPENER_H
+
+#include <stdbool.h>
+
+// Handlers for files fex does not edit itself, read once from
+// $XDG_CONFIG_HOME/fex/openers. Each line maps extensions (".pdf") or MIME
+// types ("image/png", "image/*") to a command line:
+//
+//   .pdf .djvu = zathura
+//   image/* = feh --scale-down %f
+//   .log = !less +G
+//
+// %f stands for the file and is appended when missing. A command starting
+// with ! runs in the terminal, and fex waits for it; the others are started
+// in the background.
+typedef struct opener_rule {
+  char **argv;
+  int argc;
+  bool terminal;
+} opener_rule;
+
+int opener_load(void);
+// The rule for a file by its extension, or else by its MIME type when one
+// is given; NULL when none applies
+const opener_rule *opener_match(const char *, const char *);
+int opener_run(const opener_rule *, const char *);
+
+#endif
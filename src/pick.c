@@ -0,0 +1,438 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#include "pick.h"
+#include "fold.h"
+#include "match.h"
+#include <errno.h>
+#include <locale.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Input is read straight into blocks of this size and split in place, so a
+// candidate is never copied unless it straddles two blocks
+#define PICK_BLOCK (4 << 20)
+// How often the screen catches up with input still arriving
+#define PICK_POLL_MS 20
+#define PICK_MAX_MARKS 1024
+
+typedef struct arena_block {
+  struct arena_block *next;
+  size_t size, used;
+  char data[];
+} arena_block;
+
+// Filled by the reader thread: raw holds the input as read, and folded the
+// case-folded copies of the candidates that folding changes. Split
+// candidates wait in pending, as name and folded pairs, until the screen
+// takes them.
+typedef struct pick_input {
+  char sep;
+  arena_block *raw, *folded;
+  pthread_mutex_t lock;
+  char **pending;
+  size_t n_pending, cap_pending;
+  bool done;
+  int error;
+} pick_input;
+
+static arena_block *new_block(arena_block **list, size_t size) {
+  arena_block *b = malloc(sizeof(*b) + size);
+  if (b) {
+    *b = (arena_block){*list, size, 0};
+    *list = b;
+  }
+  return b;
+}
+
+static void free_blocks(arena_block *b) {
+  while (b) {
+    arena_block *next = b->next;
+    free(b);
+    b = next;
+  }
+}
+
+// Appends a candidate and its folded form, which is the candidate itself
+// unless folding changes something
+static bool add_candidate(pick_input *in, char *name, size_t len,
+                          char ***batch, size_t *n, size_t *cap) {
+  arena_block *f = in->folded;
+  if ((!f || f->size - f->used < len + 1) &&
+      !(f = new_block(&in->folded, len + 1 > PICK_BLOCK ? len + 1
+                                                        : PICK_BLOCK)))
+    return false;
+  char *folded = f->data + f->used;
+  if (fold_utf8(name, folded))
+    f->used += len + 1;
+  else
+    folded = name;
+  if (*n + 2 > *cap) {
+    size_t new_cap = *cap ? *cap * 2 : 1024;
+    char **tmp = realloc(*batch, new_cap * sizeof(*tmp));
+    if (!tmp)
+      return false;
+    *batch = tmp;
+    *cap = new_cap;
+  }
+  (*batch)[(*n)++] = name;
+  (*batch)[(*n)++] = folded;
+  return true;
+}
+
+static bool publish(pick_input *in, char **batch, size_t n) {
+  bool ok = true;
+  if (!n)
+    return true;
+  pthread_mutex_lock(&in->lock);
+  if (in->n_pending + n > in->cap_pending) {
+    size_t cap = (in->n_pending + n) * 2;
+    char **tmp = realloc(in->pending, cap * sizeof(*tmp));
+    if ((ok = tmp != NULL)) {
+      in->pending = tmp;
+      in->cap_pending = cap;
+    }
+  }
+  if (ok) {
+    memcpy(in->pending + in->n_pending, batch, n * sizeof(*batch));
+    in->n_pending += n;
+  }
+  pthread_mutex_unlock(&in->lock);
+  return ok;
+}
+
+static void *read_input(void *p) {
+  pick_input *in = p;
+  char **batch = NULL;
+  size_t n_batch = 0, cap_batch = 0, start = 0;
+  arena_block *b = new_block(&in->raw, PICK_BLOCK);
+  int err = b ? 0 : ENOMEM;
+  bool eof = false;
+  while (!err) {
+    if (b->used == b->size || eof) {
+      // Carry the candidate in progress over to a fresh block, or at the
+      // end make room to terminate it
+      size_t tail = b->used - start;
+      if (eof && (!tail || b->used < b->size)) {
+        if (tail) {
+          b->data[b->used] = '\0';
+          if (!add_candidate(in, b->data + start, tail, &batch, &n_batch,
+                             &cap_batch))
+            err = ENOMEM;
+        }
+        break;
+      }
+      arena_block *next =
+          new_block(&in->raw, tail * 2 > PICK_BLOCK ? tail * 2 : PICK_BLOCK);
+      if (!next) {
+        err = ENOMEM;
+        break;
+      }
+      memcpy(next->data, b->data + start, tail);
+      next->used = tail;
+      start = 0;
+      b = next;
+      continue;
+    }
+    ssize_t n = read(STDIN_FILENO, b->data + b->used, b->size - b->used);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      err = n < 0 ? errno : 0;
+      eof = true;
+      continue;
+    }
+    char *scan = b->data + b->used, *end = scan + n, *sep;
+    b->used += (size_t)n;
+    while ((sep = memchr(scan, in->sep, (size_t)(end - scan)))) {
+      *sep = '\0';
+      size_t len = (size_t)(sep - (b->data + start));
+      if (len && !add_candidate(in, b->data + start, len, &batch, &n_batch,
+                                &cap_batch)) {
+        err = ENOMEM;
+        break;
+      }
+      scan = sep + 1;
+      start = (size_t)(scan - b->data);
+    }
+    if (!err && !publish(in, batch, n_batch))
+      err = ENOMEM;
+    n_batch = 0;
+  }
+  if (!err && !publish(in, batch, n_batch))
+    err = ENOMEM;
+  free(batch);
+  pthread_mutex_lock(&in->lock);
+  in->error = err;
+  in->done = true;
+  pthread_mutex_unlock(&in->lock);
+  return NULL;
+}
+
+// What the screen holds: every candidate taken so far and the best matches
+// among the first n_done of them. Candidates arriving later, or every one
+// after the query changes, are matched in batches on the executor.
+typedef struct picker {
+  char **names, **folded;
+  int n, cap;
+  fuzzy_pattern pat;
+  fuzzy_result top[MATCH_TOP_K], merged[2 * MATCH_TOP_K];
+  int n_top, n_matched, n_done;
+  match_exec ex;
+  int ex_cap, batch_lo, batch_n;
+  bool running;
+} picker;
+
+// Takes what the reader has split since last time; false once it is done
+static bool take_input(pick_input *in, picker *pk) {
+  pthread_mutex_lock(&in->lock);
+  bool more = !in->done;
+  int n = (int)(in->n_pending / 2);
+  if (pk->n + n > pk->cap) {
+    int cap = (pk->n + n) * 2;
+    char **names = realloc(pk->names, cap * sizeof(*names));
+    if (names)
+      pk->names = names;
+    char **folded = realloc(pk->folded, cap * sizeof(*folded));
+    if (folded)
+      pk->folded = folded;
+    if (names && folded)
+      pk->cap = cap;
+    else
+      n = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    pk->names[pk->n + i] = in->pending[2 * i];
+    pk->folded[pk->n + i] = in->pending[2 * i + 1];
+  }
+  pk->n += n;
+  if (n)
+    in->n_pending = 0;
+  pthread_mutex_unlock(&in->lock);
+  return more;
+}
+
+static void restart(picker *pk, const char *query) {
+  match_cancel(&pk->ex);
+  pk->running = false;
+  fuzzy_compile(&pk->pat, query);
+  pk->n_top = pk->n_matched = pk->n_done = 0;
+}
+
+// Starts matching the candidates not matched yet, or folds in the results
+// of the batch in flight once it is done
+static void advance(picker *pk) {
+  if (pk->running) {
+    if (!match_poll(&pk->ex))
+      return;
+    pk->running = false;
+    int n = pk->n_top;
+    memcpy(pk->merged, pk->top, n * sizeof(*pk->top));
+    for (int i = 0; i < pk->ex.n_top; i++) {
+      pk->merged[n] = pk->ex.top[i];
+      pk->merged[n++].index += pk->batch_lo;
+    }
+    fuzzy_sort(pk->merged, n);
+    pk->n_top = n < MATCH_TOP_K ? n : MATCH_TOP_K;
+    memcpy(pk->top, pk->merged, pk->n_top * sizeof(*pk->top));
+    pk->n_matched += pk->ex.n_set;
+    pk->n_done = pk->batch_lo + pk->batch_n;
+  }
+  if (!pk->pat.len || pk->n_done == pk->n)
+    return;
+  int n = pk->n - pk->n_done;
+  if (n > pk->ex_cap) {
+    match_exec_free(&pk->ex);
+    pk->ex_cap = n + n / 4 + 1024;
+    if (!match_exec_init(&pk->ex, pk->ex_cap)) {
+      pk->ex_cap = 0;
+      return;
+    }
+  }
+  pk->batch_lo = pk->n_done;
+  pk->batch_n = n;
+  pk->running = true;
+  match_fuzzy(&pk->ex, pk->names + pk->batch_lo, pk->folded + pk->batch_lo,
+              n, &pk->pat, false);
+}
+
+static int row_index(const picker *pk, int row) {
+  return pk->pat.len ? pk->top[row].index : row;
+}
+
+static bool is_marked(const int *marks, int n_marks, int index) {
+  for (int i = 0; i < n_marks; i++)
+    if (marks[i] == index)
+      return true;
+  return false;
+}
+
+static void draw(const picker *pk, const char *query, int selected,
+                 const int *marks, int n_marks, bool reading) {
+  int rows = LINES - 2, count = pk->pat.len ? pk->n_top : pk->n;
+  int first = selected - rows + 1 > 0 ? selected - rows + 1 : 0;
+  erase();
+  for (int r = 0; r < rows && first + r < count; r++) {
+    int index = row_index(pk, first + r);
+    if (first + r == selected)
+      attron(A_REVERSE);
+    mvprintw(r, 0, "%c %.*s", is_marked(marks, n_marks, index) ? '*' : ' ',
+             COLS > 3 ? COLS - 3 : 0, pk->names[index]);
+    if (first + r == selected)
+      attroff(A_REVERSE);
+  }
+  mvprintw(LINES - 2, 0, "  %d/%d%s%s", pk->pat.len ? pk->n_matched : pk->n,
+           pk->n, reading ? " ..." : "",
+           pk->pat.len && pk->n_done < pk->n ? " matching" : "");
+  if (n_marks)
+    printw("  (%d marked)", n_marks);
+  mvprintw(LINES - 1, 0, "> %s", query);
+  refresh();
+}
+
+int pick_run(bool null_separated) {
+  if (isatty(STDIN_FILENO)) {
+    fprintf(stderr, "fex: --pick reads its candidates from stdin\n");
+    return EXIT_FAILURE;
+  }
+  FILE *tty_in = fopen("/dev/tty", "re"), *tty_out = fopen("/dev/tty", "we");
+  if (!tty_in || !tty_out) {
+    perror("/dev/tty");
+    return EXIT_FAILURE;
+  }
+  // Static: the reader may outlive this call when the producer never stops
+  static pick_input in;
+  in.sep = null_separated ? '\0' : '\n';
+  pthread_mutex_init(&in.lock, NULL);
+  pthread_t reader;
+  if (pthread_create(&reader, NULL, read_input, &in) != 0) {
+    perror("pthread_create");
+    return EXIT_FAILURE;
+  }
+
+  setlocale(LC_ALL, "");
+  const char *term = getenv("TERM");
+  if (!newterm(term && *term ? term : "xterm", tty_out, tty_in)) {
+    fprintf(stderr, "fex: cannot open the terminal\n");
+    return EXIT_FAILURE;
+  }
+  noecho();
+  raw();
+  keypad(stdscr, TRUE);
+
+  picker pk = {0};
+  char query[FUZZY_MAX_QUERY] = {0};
+  int pos = 0, selected = 0, c = 0, marks[PICK_MAX_MARKS], n_marks = 0;
+  bool reading = true;
+  while (c != '\n' && c != 27 && c != 3) {
+    // The batch in flight reads the candidate table, so it only grows
+    // between batches
+    if (reading && !pk.running)
+      reading = take_input(&in, &pk);
+    advance(&pk);
+    int count = pk.pat.len ? pk.n_top : pk.n;
+    if (selected >= count)
+      selected = count ? count - 1 : 0;
+    draw(&pk, query, selected, marks, n_marks, reading);
+    // Poll while a batch runs or input still arrives; otherwise only a key
+    // can change anything
+    timeout(pk.running ? 1 : reading ? PICK_POLL_MS : -1);
+    if ((c = getch()) == ERR)
+      continue;
+    if ((c == KEY_BACKSPACE || c == 127) && pos > 0) {
+      query[--pos] = '\0';
+      restart(&pk, query);
+    } else if (c == KEY_UP || c == 16) // ^P
+      selected = selected > 0 ? selected - 1 : 0;
+    else if (c == KEY_DOWN || c == 14) // ^N
+      selected = selected + 1 < count ? selected + 1 : selected;
+    else if (c == '\t' && count) {
+      // Tab marks or unmarks the selection; with marks, Enter prints them
+      int index = row_index(&pk, selected), i = 0;
+      while (i < n_marks && marks[i] != index)
+        i++;
+      if (i < n_marks)
+        memmove(marks + i, marks + i + 1, (--n_marks - i) * sizeof(*marks));
+      else if (n_marks < PICK_MAX_MARKS)
+        marks[n_marks++] = index;
+    } else if (c >= 32 && c < 256 && c != 127 && pos < FUZZY_MAX_QUERY - 1) {
+      query[pos++] = (char)c;
+      query[pos] = '\0';
+      restart(&pk, query);
+      selected = 0;
+    }
+  }
+  match_cancel(&pk.ex);
+  endwin();
+  delscreen(set_term(NULL));
+  fclose(tty_in);
+  fclose(tty_out);
+
+  int count = pk.pat.len ? pk.n_top : pk.n, status = EXIT_FAILURE;
+  if (c == '\n' && (n_marks || count)) {
+    if (!n_marks)
+      marks[n_marks++] = row_index(&pk, selected);
+    for (int i = 0; i < n_marks; i++) {
+      fputs(pk.names[marks[i]], stdout);
+      putchar(in.sep);
+    }
+    status = fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  // The arenas back every candidate, so they go only once the reader has
+  // stopped; a producer still writing is left to the exit
+  pthread_mutex_lock(&in.lock);
+  bool done = in.done;
+  int err = in.error;
+  pthread_mutex_unlock(&in.lock);
+  match_exec_free(&pk.ex);
+  free(pk.names);
+  free(pk.folded);
+  if (done) {
+    pthread_join(reader, NULL);
+    free_blocks(in.raw);
+    free_blocks(in.folded);
+    free(in.pending);
+  } else
+    pthread_detach(reader);
+  if (err) {
+    errno = err;
+    perror("stdin");
+  }
+  return status;
+}
+
+#else
+
+#include "pick.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The picker reads the terminal from /dev/tty while stdin carries the
+// candidates, which has no counterpart here
+int pick_run(bool null_separated) {
+  (void)null_separated;
+  fprintf(stderr, "fex: --pick is not supported on this platform\n");
+  return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,28 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PICK_H
+#define PICK_H
+
+#include <stdbool.h>
+
+// fex_exec --pick: the fuzzy search of the browser as a general picker over
+// candidates read from stdin, one per line or NUL-terminated. Candidates are
+// matched as they arrive, and the chosen ones are printed to stdout.
+int pick_run(bool);
+
+#endif
@@ -31,14 +31,34 @@ typedef enum {
   PLATFORM_FILE_BLOCK_DEVICE,
 } PlatformFileKind;
 
+// One directory entry as it is read. size and mtime (seconds since the
+// epoch) are -1 unless asked for.
+typedef struct {
+  const char *name;
+  PlatformFileKind kind;
+  long long size, mtime;
+} PlatformEntry;
+
+// Returning nonzero stops the stream, which then returns that value
+typedef int (*platform_entry_fn)(const PlatformEntry *, void *);
+
 int platform_change_directory(const char *);
-int platform_list_directory(bool, char ***, int *);
+// Streams the entries of a directory, "." excepted and hidden ones unless
+// asked for, in the order the filesystem returns them
+int platform_stream_directory(const char *, bool, bool, platform_entry_fn,
+                              void *);
 int platform_current_directory(char *, size_t);
 PlatformFileKind platform_file_kind(const char *);
 bool platform_is_directory(const char *);
-int platform_is_text_file(const char *);
+// The MIME type of a file by its contents, such as "text/plain"
+int platform_mime_type(const char *, char *, size_t);
 int platform_describe_file(const char *, char *, size_t);
+// Full path of a program searched in $PATH, remembered between calls
+int platform_find_executable(const char *, char *, size_t);
 int platform_spawn_and_wait(char *const[]);
+int platform_spawn_detached(char *const[]);
 int platform_open_path(const char *);
+int platform_set_cloexec(int);
+int platform_pipe(int[2]);
 
 #endif
@@ -16,61 +16,104 @@ You should have received a copy of the GNU General Public License
 along with fex.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define _GNU_SOURCE // POSIX_SPAWN_SETSID
 #include "platform.h"
 #include "xdg.h"
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
-static void free_partial_names(char **names, int count) {
-  for (int i = 0; i < count; i++)
-    free(names[i]);
-  free(names);
-}
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 34)
+#define HAVE_ADDCLOSEFROM 1
+#endif
+
+extern char **environ;
+
+// Children a detached spawn left running, reaped by later spawns so they do
+// not linger as zombies
+// Children started without waiting, reaped on later spawns
+static pid_t *detached;
+static int n_detached, cap_detached;
 
 int platform_change_directory(const char *path) { return chdir(path); }
 
-int platform_list_directory(bool show_hidden_files, char ***names, int *count) {
-  DIR *dir = opendir(".");
+static PlatformFileKind kind_of_mode(mode_t mode) {
+  switch (mode & S_IFMT) {
+  case S_IFLNK:
+    return PLATFORM_FILE_SYMLINK;
+  case S_IFDIR:
+    return PLATFORM_FILE_DIRECTORY;
+  case S_IFCHR:
+    return PLATFORM_FILE_CHAR_DEVICE;
+  case S_IFBLK:
+    return PLATFORM_FILE_BLOCK_DEVICE;
+  default:
+    return PLATFORM_FILE_REGULAR;
+  }
+}
+
+// The kind readdir already knows, which saves a stat per entry
+static PlatformFileKind kind_of_dirent(const struct dirent *entry) {
+#ifdef DT_UNKNOWN
+  switch (entry->d_type) {
+  case DT_LNK:
+    return PLATFORM_FILE_SYMLINK;
+  case DT_DIR:
+    return PLATFORM_FILE_DIRECTORY;
+  case DT_CHR:
+    return PLATFORM_FILE_CHAR_DEVICE;
+  case DT_BLK:
+    return PLATFORM_FILE_BLOCK_DEVICE;
+  case DT_UNKNOWN:
+    return PLATFORM_FILE_UNKNOWN;
+  default:
+    return PLATFORM_FILE_REGULAR;
+  }
+#else
+  (void)entry;
+  return PLATFORM_FILE_UNKNOWN;
+#endif
+}
+
+int platform_stream_directory(const char *path, bool show_hidden_files,
+                              bool want_stat, platform_entry_fn fn,
+                              void *arg) {
+  DIR *dir = opendir(path);
   if (!dir)
     return -1;
 
-  *names = NULL;
-  *count = 0;
-
+  int ret = 0;
   struct dirent *entry;
-  while ((entry = readdir(dir)) != NULL) {
-    if (strcmp(entry->d_name, ".") == 0)
+  while (!ret && (entry = readdir(dir)) != NULL) {
+    const char *name = entry->d_name;
+    if (strcmp(name, ".") == 0)
       continue;
-    if (!show_hidden_files && entry->d_name[0] == '.' &&
-        entry->d_name[1] != '.')
+    if (!show_hidden_files && name[0] == '.' && name[1] != '.')
       continue;
 
-    char **tmp = realloc(*names, (*count + 1) * sizeof(*tmp));
-    if (!tmp) {
-      free_partial_names(*names, *count);
-      *names = NULL;
-      *count = 0;
-      closedir(dir);
-      return -1;
+    PlatformEntry e = {name, kind_of_dirent(entry), -1, -1};
+    struct stat st;
+    if (want_stat &&
+        fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+      e.kind = kind_of_mode(st.st_mode);
+      e.size = st.st_size;
+      e.mtime = st.st_mtime;
     }
-    *names = tmp;
-    (*names)[*count] = strdup(entry->d_name);
-    if (!(*names)[*count]) {
-      free_partial_names(*names, *count);
-      *names = NULL;
-      *count = 0;
-      closedir(dir);
-      return -1;
-    }
-    (*count)++;
+    ret = fn(&e, arg);
   }
   closedir(dir);
-  return 0;
+  return ret;
 }
 
 int platform_current_directory(char *buffer, size_t size) {
@@ -81,18 +124,7 @@ PlatformFileKind platform_file_kind(const char *path) {
   struct stat st;
   if (lstat(path, &st) != 0)
     return PLATFORM_FILE_UNKNOWN;
-  switch (st.st_mode & S_IFMT) {
-  case S_IFLNK:
-    return PLATFORM_FILE_SYMLINK;
-  case S_IFDIR:
-    return PLATFORM_FILE_DIRECTORY;
-  case S_IFCHR:
-    return PLATFORM_FILE_CHAR_DEVICE;
-  case S_IFBLK:
-    return PLATFORM_FILE_BLOCK_DEVICE;
-  default:
-    return PLATFORM_FILE_REGULAR;
-  }
+  return kind_of_mode(st.st_mode);
 }
 
 bool platform_is_directory(const char *path) {
@@ -102,51 +134,285 @@ bool platform_is_directory(const char *path) {
   return S_ISDIR(st.st_mode);
 }
 
-int platform_is_text_file(const char *filepath) {
-  char command[512], mime[1024] = {0};
-  FILE *fp;
-  snprintf(command, sizeof(command), "file --mime-type -b \"%s\"", filepath);
-  if (!(fp = popen(command, "r")))
-    return 0;
-  if (!fgets(mime, sizeof(mime), fp)) {
-    pclose(fp);
-    return 0;
+#ifndef HAVE_ADDCLOSEFROM
+// Fallback for spawns that cannot close descriptors in the child: marks
+// every descriptor above stderr close-on-exec, whoever opened it
+static void mark_fds_cloexec(void) {
+#ifdef __linux__
+  DIR *dir = opendir("/proc/self/fd");
+#else
+  DIR *dir = opendir("/dev/fd");
+#endif
+  if (!dir)
+    return;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    int fd = atoi(entry->d_name);
+    if (fd > 2 && fd != dirfd(dir))
+      platform_set_cloexec(fd);
   }
-  pclose(fp);
-  mime[strcspn(mime, "\n")] = '\0';
-  return strncmp(mime, "text/", 5) == 0;
+  closedir(dir);
 }
+#endif
 
-int platform_describe_file(const char *filepath, char *buffer, size_t size) {
-  char command[512];
-  FILE *fp;
-  snprintf(command, sizeof(command), "file \"%s\"", filepath);
-  fp = popen(command, "r");
-  if (!fp)
-    return -1;
+// Programs found in $PATH. A hit costs no system call: a changed $PATH is
+// seen by comparing strings, and the file behind an entry is stat'ed again
+// at most once a second, so an upgrade that replaces it is picked up.
+#define MAX_RESOLVED 8
+#define RECHECK_NS 1000000000LL
+static struct resolved {
+  char name[64];
+  char path[PATH_MAX];
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  long long checked;
+} resolved[MAX_RESOLVED];
+static int n_resolved, next_evict;
+static char *resolved_for; // the $PATH the entries were found in
+// The server describes files from several threads at once
+static pthread_mutex_t resolved_lock = PTHREAD_MUTEX_INITIALIZER;
 
-  if (size)
-    buffer[0] = '\0';
+static long long monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-  char line[1024];
-  while (fgets(line, sizeof(line), fp))
-    strncat(buffer, line, size - strlen(buffer) - 1);
+static bool same_file(const struct resolved *r, const struct stat *st) {
+  return r->dev == st->st_dev && r->ino == st->st_ino &&
+         r->mtime.tv_sec == st->st_mtim.tv_sec &&
+         r->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
 
-  return pclose(fp);
+// Looks name up, with resolved_lock held
+static struct resolved *resolve(const char *name) {
+  const char *env = getenv("PATH");
+  if (!env)
+    env = "";
+  if (!resolved_for || strcmp(resolved_for, env) != 0) {
+    free(resolved_for);
+    resolved_for = strdup(env);
+    n_resolved = 0;
+  }
+  struct stat st;
+  long long now = monotonic_ns();
+  for (int i = 0; i < n_resolved; i++) {
+    struct resolved *r = &resolved[i];
+    if (strcmp(r->name, name) != 0)
+      continue;
+    if (now - r->checked < RECHECK_NS)
+      return r;
+    if (stat(r->path, &st) == 0 && same_file(r, &st)) {
+      r->checked = now;
+      return r;
+    }
+    resolved[i] = resolved[--n_resolved];
+    break;
+  }
+  if (strlen(name) >= sizeof(resolved->name))
+    return NULL;
+  char path[PATH_MAX];
+  if (!findExecutable(name, path, sizeof(path)) || stat(path, &st) != 0)
+    return NULL;
+  struct resolved *r;
+  if (n_resolved < MAX_RESOLVED) {
+    r = &resolved[n_resolved++];
+  } else {
+    r = &resolved[next_evict];
+    next_evict = (next_evict + 1) % MAX_RESOLVED;
+  }
+  strcpy(r->name, name);
+  strcpy(r->path, path);
+  r->dev = st.st_dev;
+  r->ino = st.st_ino;
+  r->mtime = st.st_mtim;
+  r->checked = now;
+  return r;
 }
 
-int platform_spawn_and_wait(char *const argv[]) {
-  pid_t pid = fork();
-  if (pid == 0) {
-    execvp(argv[0], argv);
-    _exit(EXIT_FAILURE);
-  } else if (pid < 0) {
+// Drops name, so the next lookup walks $PATH again
+static void forget_executable(const char *name) {
+  pthread_mutex_lock(&resolved_lock);
+  for (int i = 0; i < n_resolved; i++)
+    if (strcmp(resolved[i].name, name) == 0) {
+      resolved[i] = resolved[--n_resolved];
+      break;
+    }
+  pthread_mutex_unlock(&resolved_lock);
+}
+
+int platform_find_executable(const char *name, char *buf, size_t size) {
+  pthread_mutex_lock(&resolved_lock);
+  struct resolved *r = resolve(name);
+  bool found = r && strlen(r->path) < size;
+  if (found)
+    strcpy(buf, r->path);
+  pthread_mutex_unlock(&resolved_lock);
+  return found;
+}
+
+static void reap_detached(void) {
+  for (int i = 0; i < n_detached;)
+    if (waitpid(detached[i], NULL, WNOHANG) != 0)
+      detached[i] = detached[--n_detached];
+    else
+      i++;
+}
+
+// Starts argv[0], searched in $PATH through the cache above. posix_spawn
+// never copies fex's address space, so starting a helper costs the same
+// however large the caches have grown. out, unless -1, becomes the child's
+// stdout; a detached child gets a session of its own and /dev/null for its
+// standard streams.
+static pid_t spawn(char *const argv[], int out, bool detach) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t defaults;
+  short flags = POSIX_SPAWN_SETSIGDEF;
+  pid_t pid;
+  reap_detached();
+  if (posix_spawn_file_actions_init(&actions) != 0)
+    return -1;
+  if (posix_spawnattr_init(&attr) != 0) {
+    posix_spawn_file_actions_destroy(&actions);
     return -1;
   }
-  int status;
-  if (waitpid(pid, &status, 0) == -1)
+  // The server ignores SIGPIPE; its children should not
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  if (out >= 0)
+    posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+  // Only the standard streams reach the child, even descriptors a library
+  // opened without O_CLOEXEC; glibc closes the rest with close_range
+#ifdef HAVE_ADDCLOSEFROM
+  posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#else
+  mark_fds_cloexec();
+#endif
+  if (detach) {
+    for (int fd = 0; fd < 3; fd++)
+      posix_spawn_file_actions_addopen(&actions, fd, "/dev/null", O_RDWR, 0);
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#else
+    flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+  }
+  posix_spawnattr_setflags(&attr, flags);
+  char path[PATH_MAX];
+  bool search = !strchr(argv[0], '/');
+  int err = ENOENT;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (search && !platform_find_executable(argv[0], path, sizeof(path)))
+      break;
+    err = posix_spawn(&pid, search ? path : argv[0], &actions, &attr, argv,
+                      environ);
+    // A cached path that went stale between checks is looked up afresh
+    if (!search || (err != ENOENT && err != EACCES && err != ENOEXEC))
+      break;
+    forget_executable(argv[0]);
+  }
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err) {
+    errno = err;
     return -1;
+  }
+  if (detach && n_detached == cap_detached) {
+    int cap = cap_detached ? cap_detached * 2 : 16;
+    pid_t *grown = realloc(detached, cap * sizeof(*detached));
+    if (grown) {
+      detached = grown;
+      cap_detached = cap;
+    }
+  }
+  if (detach && n_detached < cap_detached)
+    detached[n_detached++] = pid;
+  return pid;
+}
+
+static int wait_child(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) == -1)
+    if (errno != EINTR)
+      return -1;
   return status;
 }
 
+// Runs argv and reads what it prints into buf. Unlike popen there is no
+// shell in between, so file names need no quoting.
+static int run_capture(char *const argv[], char *buf, size_t size) {
+  int fds[2];
+  if (size)
+    buf[0] = '\0';
+  if (platform_pipe(fds) != 0)
+    return -1;
+  pid_t pid = spawn(argv, fds[1], false);
+  close(fds[1]);
+  if (pid < 0) {
+    close(fds[0]);
+    return -1;
+  }
+  size_t used = 0;
+  char discard[256];
+  for (;;) {
+    // Output past the buffer is drained so the child is never blocked
+    bool room = used + 1 < size;
+    ssize_t n = read(fds[0], room ? buf + used : discard,
+                     room ? size - used - 1 : sizeof(discard));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    if (room)
+      used += (size_t)n;
+  }
+  if (size)
+    buf[used] = '\0';
+  close(fds[0]);
+  return wait_child(pid);
+}
+
+int platform_mime_type(const char *filepath, char *buf, size_t size) {
+  char *argv[] = {"file", "--mime-type", "-b", "--", (char *)filepath, NULL};
+  if (run_capture(argv, buf, size) == -1)
+    return -1;
+  buf[strcspn(buf, "\n")] = '\0';
+  return *buf ? 0 : -1;
+}
+
+int platform_describe_file(const char *filepath, char *buffer, size_t size) {
+  char *argv[] = {"file", "--", (char *)filepath, NULL};
+  return run_capture(argv, buffer, size);
+}
+
+int platform_spawn_and_wait(char *const argv[]) {
+  pid_t pid = spawn(argv, -1, false);
+  return pid < 0 ? -1 : wait_child(pid);
+}
+
+int platform_spawn_detached(char *const argv[]) {
+  return spawn(argv, -1, true) < 0 ? -1 : 0;
+}
+
 int platform_open_path(const char *path) { return openFile(path); }
+
+int platform_set_cloexec(int fd) {
+  int flags = fcntl(fd, F_GETFD);
+  return flags < 0 ? -1 : fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+// A pipe whose ends are close-on-exec from the start, where pipe2 exists
+int platform_pipe(int fds[2]) {
+#ifdef __APPLE__
+  if (pipe(fds) != 0)
+    return -1;
+  platform_set_cloexec(fds[0]);
+  platform_set_cloexec(fds[1]);
+  return 0;
+#else
+  return pipe2(fds, O_CLOEXEC);
+#endif
+}
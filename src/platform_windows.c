@@ -18,6 +18,8 @@ along with fex.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "platform.h"
 #include <direct.h>
+#include <fcntl.h>
+#include <io.h>
 #include <process.h>
 #include <shellapi.h>
 #include <stdio.h>
@@ -25,23 +27,26 @@ along with fex.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <windows.h>
 
-static void free_partial_names(char **names, int count) {
-  for (int i = 0; i < count; i++)
-    free(names[i]);
-  free(names);
-}
-
 int platform_change_directory(const char *path) { return _chdir(path); }
 
-int platform_list_directory(bool show_hidden_files, char ***names, int *count) {
+// Modification times in FILETIME ticks since 1601, as Unix seconds
+static long long unix_seconds(FILETIME t) {
+  unsigned long long ticks =
+      ((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime;
+  return (long long)(ticks / 10000000ULL) - 11644473600LL;
+}
+
+int platform_stream_directory(const char *path, bool show_hidden_files,
+                              bool want_stat, platform_entry_fn fn,
+                              void *arg) {
+  char pattern[MAX_PATH];
   WIN32_FIND_DATAA ffd;
-  HANDLE hFind = FindFirstFileA("*", &ffd);
+  snprintf(pattern, sizeof(pattern), "%s\\*", path);
+  HANDLE hFind = FindFirstFileA(pattern, &ffd);
   if (hFind == INVALID_HANDLE_VALUE)
     return -1;
 
-  *names = NULL;
-  *count = 0;
-
+  int ret = 0;
   do {
     const char *name = ffd.cFileName;
     if (strcmp(name, ".") == 0)
@@ -50,28 +55,24 @@ int platform_list_directory(bool show_hidden_files, char ***names, int *count) {
         strcmp(name, "..") != 0)
       continue;
 
-    char **tmp = realloc(*names, (*count + 1) * sizeof(*tmp));
-    if (!tmp) {
-      free_partial_names(*names, *count);
-      *names = NULL;
-      *count = 0;
-      FindClose(hFind);
-      return -1;
-    }
-    *names = tmp;
-    (*names)[*count] = _strdup(name);
-    if (!(*names)[*count]) {
-      free_partial_names(*names, *count);
-      *names = NULL;
-      *count = 0;
-      FindClose(hFind);
-      return -1;
-    }
-    (*count)++;
-  } while (FindNextFileA(hFind, &ffd) != 0);
+    // The find data carries everything, so want_stat costs nothing here
+    (void)want_stat;
+    PlatformEntry e = {name, PLATFORM_FILE_REGULAR,
+                       (long long)(((unsigned long long)ffd.nFileSizeHigh
+                                    << 32) |
+                                   ffd.nFileSizeLow),
+                       unix_seconds(ffd.ftLastWriteTime)};
+    if (ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+      e.kind = PLATFORM_FILE_SYMLINK;
+    else if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      e.kind = PLATFORM_FILE_DIRECTORY;
+    else if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DEVICE)
+      e.kind = PLATFORM_FILE_CHAR_DEVICE;
+    ret = fn(&e, arg);
+  } while (!ret && FindNextFileA(hFind, &ffd) != 0);
 
   FindClose(hFind);
-  return 0;
+  return ret;
 }
 
 int platform_current_directory(char *buffer, size_t size) {
@@ -98,17 +99,18 @@ bool platform_is_directory(const char *path) {
   return (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
 }
 
-int platform_is_text_file(const char *filepath) {
+// Without `file`, only text is told apart: a file with no NUL byte in its
+// first kilobyte
+int platform_mime_type(const char *filepath, char *mime, size_t size) {
   FILE *fp = fopen(filepath, "rb");
   if (!fp)
-    return 0;
+    return -1;
   unsigned char buf[1024];
   size_t n = fread(buf, 1, sizeof(buf), fp);
   fclose(fp);
-  for (size_t i = 0; i < n; i++)
-    if (buf[i] == '\0')
-      return 0;
-  return 1;
+  bool text = memchr(buf, '\0', n) == NULL;
+  snprintf(mime, size, "%s", text ? "text/plain" : "application/octet-stream");
+  return 0;
 }
 
 int platform_describe_file(const char *filepath, char *buffer, size_t size) {
@@ -132,11 +134,32 @@ int platform_describe_file(const char *filepath, char *buffer, size_t size) {
   return 0;
 }
 
+int platform_find_executable(const char *name, char *buf, size_t size) {
+  DWORD n = SearchPathA(NULL, name, ".exe", (DWORD)size, buf, NULL);
+  return n > 0 && n < size;
+}
+
 int platform_spawn_and_wait(char *const argv[]) {
   return (int)_spawnvp(_P_WAIT, argv[0], (const char *const *)argv);
 }
 
+int platform_spawn_detached(char *const argv[]) {
+  return _spawnvp(_P_DETACH, argv[0], (const char *const *)argv) == -1 ? -1
+                                                                       : 0;
+}
+
 int platform_open_path(const char *path) {
   HINSTANCE res = ShellExecuteA(NULL, "open", path, NULL, NULL, SW_SHOWNORMAL);
   return ((INT_PTR)res <= 32) ? 1 : 0;
 }
+
+int platform_pipe(int fds[2]) {
+  return _pipe(fds, 4096, _O_BINARY | _O_NOINHERIT);
+}
+
+int platform_set_cloexec(int fd) {
+  HANDLE h = (HANDLE)_get_osfhandle(fd);
+  if (h == INVALID_HANDLE_VALUE)
+    return -1;
+  return SetHandleInformation(h, HANDLE_FLAG_INHERIT, 0) ? 0 : -1;
+}
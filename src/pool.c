@@ -0,0 +1,178 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define POOL_MAX_WORKERS 64
+
+// One loop at a time: generation tells sleeping workers a new one started,
+// next hands out chunks and done counts the finished ones.
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t work, idle;
+  pthread_t threads[POOL_MAX_WORKERS];
+  int n_threads, started, stopping;
+  unsigned long generation;
+  pool_fn fn;
+  void *arg;
+  int n_chunks, next, done, busy;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER,
+          .work = PTHREAD_COND_INITIALIZER,
+          .idle = PTHREAD_COND_INITIALIZER};
+
+static void run_chunks(pool_fn fn, void *arg, int n_chunks, int worker) {
+  int chunk, finished = 0;
+  while ((chunk = __atomic_fetch_add(&pool.next, 1, __ATOMIC_SEQ_CST)) <
+         n_chunks) {
+    fn(arg, chunk, worker);
+    finished++;
+  }
+  if (finished &&
+      __atomic_add_fetch(&pool.done, finished, __ATOMIC_SEQ_CST) == n_chunks) {
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_broadcast(&pool.idle);
+    pthread_mutex_unlock(&pool.lock);
+  }
+}
+
+static void *worker_main(void *p) {
+  int worker = (int)(long)p;
+  unsigned long seen = 0;
+  pthread_mutex_lock(&pool.lock);
+  while (1) {
+    while (pool.generation == seen && !pool.stopping)
+      pthread_cond_wait(&pool.work, &pool.lock);
+    if (pool.stopping)
+      break;
+    // A loop is only set up while no thread is busy, so these stay valid
+    // until this thread is done with them
+    seen = pool.generation;
+    pool.busy++;
+    pool_fn fn = pool.fn;
+    void *arg = pool.arg;
+    int n_chunks = pool.n_chunks;
+    pthread_mutex_unlock(&pool.lock);
+    run_chunks(fn, arg, n_chunks, worker);
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.busy == 0)
+      pthread_cond_broadcast(&pool.idle);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+static void start_pool(void) {
+  // One thread per CPU, as pool_start leaves the caller free; pool_run adds
+  // the caller as worker 0 and threads that fail to start are simply absent
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int want = cpus > 1 ? (int)cpus : 1;
+  if (want > POOL_MAX_WORKERS - 1)
+    want = POOL_MAX_WORKERS - 1;
+  for (; pool.n_threads < want; pool.n_threads++)
+    if (pthread_create(&pool.threads[pool.n_threads], NULL, worker_main,
+                       (void *)(long)(pool.n_threads + 1)) != 0)
+      break;
+  pool.started = 1;
+}
+
+int pool_workers(void) {
+  pthread_mutex_lock(&pool.lock);
+  if (!pool.started)
+    start_pool();
+  int n = pool.n_threads + 1;
+  pthread_mutex_unlock(&pool.lock);
+  return n;
+}
+
+// Publishes a loop to the threads. Called with pool.lock held and returns
+// with it released.
+static void publish_loop(int n_chunks, pool_fn fn, void *arg) {
+  // A thread that woke late for the previous loop must leave it first
+  while (pool.busy)
+    pthread_cond_wait(&pool.idle, &pool.lock);
+  pool.fn = fn;
+  pool.arg = arg;
+  pool.n_chunks = n_chunks;
+  pool.next = 0;
+  pool.done = 0;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+}
+
+void pool_run(int n_chunks, pool_fn fn, void *arg) {
+  if (n_chunks <= 0)
+    return;
+  pthread_mutex_lock(&pool.lock);
+  if (!pool.started)
+    start_pool();
+  if (n_chunks == 1 || !pool.n_threads) {
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < n_chunks; i++)
+      fn(arg, i, 0);
+    return;
+  }
+  publish_loop(n_chunks, fn, arg);
+  run_chunks(fn, arg, n_chunks, 0);
+  pool_wait();
+}
+
+void pool_start(int n_chunks, pool_fn fn, void *arg) {
+  if (n_chunks <= 0)
+    return;
+  pthread_mutex_lock(&pool.lock);
+  if (!pool.started)
+    start_pool();
+  if (!pool.n_threads) {
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < n_chunks; i++)
+      fn(arg, i, 0);
+    return;
+  }
+  publish_loop(n_chunks, fn, arg);
+}
+
+bool pool_idle(void) {
+  pthread_mutex_lock(&pool.lock);
+  bool idle = __atomic_load_n(&pool.done, __ATOMIC_SEQ_CST) >= pool.n_chunks &&
+              !pool.busy;
+  pthread_mutex_unlock(&pool.lock);
+  return idle;
+}
+
+void pool_wait(void) {
+  pthread_mutex_lock(&pool.lock);
+  while (__atomic_load_n(&pool.done, __ATOMIC_SEQ_CST) < pool.n_chunks ||
+         pool.busy)
+    pthread_cond_wait(&pool.idle, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+}
+
+void pool_shutdown(void) {
+  pthread_mutex_lock(&pool.lock);
+  pool.stopping = 1;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+  for (int i = 0; i < pool.n_threads; i++)
+    pthread_join(pool.threads[i], NULL);
+  pool.n_threads = 0;
+  pool.started = 0;
+  pool.stopping = 0;
+}
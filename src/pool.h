@@ -0,0 +1,39 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+
+// Process-wide pool of worker threads for data-parallel loops. fn is called
+// once for every chunk in [0, n_chunks), on whichever thread claims it
+// first; worker identifies that thread, in [0, pool_workers()), so callers
+// can keep per-thread scratch state. pool_run works on the calling thread
+// too and returns once every chunk is done. pool_start only hands the loop
+// to the pool; the caller then checks pool_idle or blocks in pool_wait
+// before starting another. One loop runs at a time.
+typedef void (*pool_fn)(void *, int chunk, int worker);
+
+int pool_workers(void);
+void pool_run(int, pool_fn, void *);
+void pool_start(int, pool_fn, void *);
+bool pool_idle(void);
+void pool_wait(void);
+void pool_shutdown(void);
+
+#endif
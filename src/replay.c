@@ -0,0 +1,237 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#include "replay.h"
+#include "platform.h"
+#include "timing.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Keys in one step, well under what a pipe holds, and how long a step may
+// take before the replay gives up on it
+#define REPLAY_MAX_KEYS 512
+#define REPLAY_STEP_SECONDS 10
+
+typedef struct replay_step {
+  char *line; // as written in the script, for the report
+  char keys[REPLAY_MAX_KEYS];
+  size_t n_keys;
+  long long total, phases[REPLAY_PHASES];
+} replay_step;
+
+static replay_step *steps;
+static int n_steps, current = -1;
+static int feed_fd = -1;
+static long long started;
+
+static const char *phase_names[REPLAY_PHASES] = {"load", "describe",
+                                                 "search", "render"};
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// One step per line, written as typed with C-style escapes: \n for Enter,
+// \e for Escape, \t, \\ and \xHH. Blank lines and lines starting with # are
+// skipped.
+static bool parse_step(const char *line, replay_step *step) {
+  step->n_keys = 0;
+  for (const char *p = line; *p; p++) {
+    char c = *p;
+    if (c == '\\') {
+      switch (*++p) {
+      case 'n':
+        c = '\n';
+        break;
+      case 'e':
+        c = 27;
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case '\\':
+        c = '\\';
+        break;
+      case 'x':
+        if (hex_digit(p[1]) < 0 || hex_digit(p[2]) < 0)
+          return false;
+        c = (char)(hex_digit(p[1]) * 16 + hex_digit(p[2]));
+        p += 2;
+        break;
+      default:
+        return false;
+      }
+    }
+    if (step->n_keys == REPLAY_MAX_KEYS)
+      return false;
+    step->keys[step->n_keys++] = c;
+  }
+  return step->n_keys > 0;
+}
+
+static void step_timeout(int signum) {
+  static const char msg[] = "fex: replay step did not finish within "
+                            "10 s; does it complete its action?\n";
+  (void)signum;
+  ssize_t n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+  (void)n;
+  _exit(EXIT_FAILURE);
+}
+
+// Reads the script and hands back the terminal to create the screen with:
+// keys come in on in, and everything drawn goes to out
+bool replay_open(const char *script, FILE **in, FILE **out) {
+  FILE *fp = fopen(script, "re");
+  if (!fp) {
+    perror(script);
+    return false;
+  }
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  int lineno = 0;
+  while ((len = getline(&line, &cap, fp)) >= 0) {
+    lineno++;
+    if (len && line[len - 1] == '\n')
+      line[--len] = '\0';
+    if (!len || line[0] == '#')
+      continue;
+    replay_step *tmp = realloc(steps, (n_steps + 1) * sizeof(*steps));
+    if (!tmp) {
+      perror(script);
+      break;
+    }
+    steps = tmp;
+    steps[n_steps] = (replay_step){0};
+    if (!parse_step(line, &steps[n_steps])) {
+      fprintf(stderr, "%s:%d: bad step\n", script, lineno);
+      break;
+    }
+    if (!(steps[n_steps].line = strdup(line))) {
+      perror(script);
+      break;
+    }
+    n_steps++;
+  }
+  bool ok = len < 0 && !ferror(fp);
+  free(line);
+  fclose(fp);
+  if (!ok)
+    return false;
+
+  int fds[2];
+  if (platform_pipe(fds) != 0) {
+    perror("pipe");
+    return false;
+  }
+  feed_fd = fds[1];
+  if (!(*in = fdopen(fds[0], "r")) || !(*out = fopen("/dev/null", "we"))) {
+    perror("replay");
+    return false;
+  }
+  signal(SIGALRM, step_timeout);
+  return true;
+}
+
+// Closes the step in progress and feeds the next; false once the script has
+// run out
+bool replay_next(void) {
+  long long now = timing_now();
+  if (current >= 0)
+    steps[current].total = now - started;
+  if (current + 1 >= n_steps) {
+    alarm(0);
+    current = n_steps;
+    return false;
+  }
+  replay_step *step = &steps[++current];
+  alarm(REPLAY_STEP_SECONDS);
+  started = timing_now();
+  return write(feed_fd, step->keys, step->n_keys) == (ssize_t)step->n_keys;
+}
+
+long long replay_begin(void) {
+  return current >= 0 && current < n_steps ? timing_now() : 0;
+}
+
+void replay_end(enum replay_phase phase, long long begin) {
+  if (begin && current >= 0 && current < n_steps)
+    steps[current].phases[phase] += timing_now() - begin;
+}
+
+void replay_report(FILE *out) {
+  long long total = 0, phases[REPLAY_PHASES] = {0};
+  fprintf(out, "%-5s %-16s %10s", "step", "keys", "total ms");
+  for (int p = 0; p < REPLAY_PHASES; p++)
+    fprintf(out, " %10s", phase_names[p]);
+  fputc('\n', out);
+  for (int i = 0; i < n_steps; i++) {
+    replay_step *step = &steps[i];
+    fprintf(out, "%-5d %-16.16s %10.3f", i + 1, step->line, step->total / 1e6);
+    for (int p = 0; p < REPLAY_PHASES; p++) {
+      fprintf(out, " %10.3f", step->phases[p] / 1e6);
+      phases[p] += step->phases[p];
+    }
+    fputc('\n', out);
+    total += step->total;
+    free(step->line);
+  }
+  fprintf(out, "%-5s %-16s %10.3f", "all", "", total / 1e6);
+  for (int p = 0; p < REPLAY_PHASES; p++)
+    fprintf(out, " %10.3f", phases[p] / 1e6);
+  fputc('\n', out);
+  free(steps);
+  steps = NULL;
+  n_steps = 0;
+}
+
+#else
+
+#include "replay.h"
+#include <stdio.h>
+
+// Replays need a pipe to stand in for the terminal, which is posix-only here
+bool replay_open(const char *script, FILE **in, FILE **out) {
+  (void)script;
+  (void)in;
+  (void)out;
+  fprintf(stderr, "fex: --replay is not supported on this platform\n");
+  return false;
+}
+
+bool replay_next(void) { return false; }
+
+void replay_report(FILE *out) { (void)out; }
+
+long long replay_begin(void) { return 0; }
+
+void replay_end(enum replay_phase phase, long long begin) {
+  (void)phase;
+  (void)begin;
+}
+
+#endif
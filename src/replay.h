@@ -0,0 +1,45 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Replays a script of keystrokes through the browser's own loop for
+// benchmarking. The screen is drawn to /dev/null and keys arrive on a pipe
+// standing in for the terminal, one step at a time: a step is fed once the
+// browser has settled, having described and drawn, after the one before.
+// A step's latency runs until the browser settles again, split into the
+// phases below.
+enum replay_phase {
+  REPLAY_LOAD,
+  REPLAY_DESCRIBE,
+  REPLAY_SEARCH,
+  REPLAY_RENDER,
+  REPLAY_PHASES
+};
+
+bool replay_open(const char *, FILE **, FILE **);
+bool replay_next(void);
+void replay_report(FILE *);
+// Time spent in a phase; both are free when nothing is being replayed
+long long replay_begin(void);
+void replay_end(enum replay_phase, long long);
+
+#endif
@@ -0,0 +1,644 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#define _GNU_SOURCE // struct ucred
+#include "server.h"
+#include "platform.h"
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// Listings kept, the least recently used replaced first, and description
+// slots, each replaced by any other path hashing to it
+#define SERVER_MAX_DIRS 64
+#define SERVER_DESCRIPTIONS 1024
+// How long a session waits on the server before doing the work itself
+#define SERVER_TIMEOUT_MS 2000
+// Without an inotify watch a listing or description is trusted only if its
+// mtime was this far behind the clock when it was read, as in the tree index
+#define RACY_SECONDS 2
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Requests are single lines, "L0\t<dir>" or "L1\t<dir>" for a listing without
+// or with hidden entries and "D\t<path>" for a description. Each reply is a
+// line "<errno> <count> <size>" followed by size bytes: NUL-terminated names
+// for a listing, or what `file` printed after the path for a description.
+
+typedef struct listing {
+  char *dir, *names; // names NUL-separated, sorted, ".." first
+  size_t size;
+  int n, wd;
+  struct stat st;
+  time_t read_at;
+  unsigned long used;
+} listing;
+
+typedef struct description {
+  char *path, *text;
+  struct stat st;
+} description;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static listing listings[SERVER_MAX_DIRS];
+static description descriptions[SERVER_DESCRIPTIONS];
+static unsigned long tick;
+static int notify_fd = -1;
+static volatile sig_atomic_t stopping;
+
+static int server_fd = -1;
+static FILE *server_in;
+
+static uint64_t hash_path(const char *s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+  return h;
+}
+
+// The socket lives in a directory only this user can enter, which is what
+// keeps other users from either end of it
+static bool socket_path(char *buf, size_t size, bool create) {
+  const char *run = getenv("XDG_RUNTIME_DIR");
+  char dir[PATH_MAX];
+  int n;
+  if (run && *run == '/')
+    n = snprintf(dir, sizeof(dir), "%s/fex", run);
+  else
+    n = snprintf(dir, sizeof(dir), "/tmp/fex-%u", (unsigned)getuid());
+  if (n <= 0 || (size_t)n >= sizeof(dir))
+    return false;
+  if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+    return false;
+  struct stat st;
+  if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+      st.st_uid != getuid() || (st.st_mode & 077))
+    return false;
+  n = snprintf(buf, size, "%s/server.sock", dir);
+  return n > 0 && (size_t)n < size;
+}
+
+static int unix_socket(void) {
+#ifdef SOCK_CLOEXEC
+  return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0)
+    platform_set_cloexec(fd);
+  return fd;
+#endif
+}
+
+static int dial(const struct sockaddr_un *addr) {
+  int fd = unix_socket();
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool write_all(int fd, const char *buf, size_t size) {
+  while (size) {
+    ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    buf += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+static bool same_file(const struct stat *a, const struct stat *b) {
+  return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+         a->st_size == b->st_size &&
+         a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+         a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+         a->st_ctim.tv_sec == b->st_ctim.tv_sec &&
+         a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+// Same order and hidden rule as the browser's own listing
+static int cmp_names(const void *a, const void *b) {
+  const char *sa = *(const char *const *)a;
+  const char *sb = *(const char *const *)b;
+  bool da = strcmp(sa, "..") == 0, db = strcmp(sb, "..") == 0;
+  if (da || db)
+    return db - da;
+  return strcmp(sa, sb);
+}
+
+static bool hidden_name(const char *name) {
+  return name[0] == '.' && name[1] != '.';
+}
+
+// Also undoes a read that failed after adding its watch
+static void drop_listing(listing *l) {
+  if (!l->dir && l->wd < 0)
+    return;
+#ifdef __linux__
+  // Two paths to one directory share a watch
+  bool shared = false;
+  for (int i = 0; i < SERVER_MAX_DIRS; i++)
+    shared |= &listings[i] != l && listings[i].dir && listings[i].wd == l->wd;
+  if (l->wd >= 0 && !shared)
+    inotify_rm_watch(notify_fd, l->wd);
+#endif
+  free(l->dir);
+  free(l->names);
+  *l = (listing){.wd = -1};
+}
+
+// Reads dir into l. The watch is added before the directory is read, so a
+// change made while reading still drops the listing afterwards.
+static int read_listing(const char *dir, listing *l) {
+  *l = (listing){.wd = -1, .read_at = time(NULL)};
+  if (stat(dir, &l->st) != 0)
+    return errno;
+#ifdef __linux__
+  if (notify_fd >= 0)
+    l->wd = inotify_add_watch(notify_fd, dir,
+                              IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                  IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                  IN_ONLYDIR);
+#endif
+  DIR *d = opendir(dir);
+  if (!d)
+    return errno;
+  char *raw = NULL, **names = NULL;
+  size_t *offs = NULL, size = 0, raw_cap = 0;
+  int n = 0, cap = 0, err = 0;
+  struct dirent *e;
+  while (!err && (e = readdir(d))) {
+    if (strcmp(e->d_name, ".") == 0)
+      continue;
+    size_t len = strlen(e->d_name) + 1;
+    if (size + len > raw_cap) {
+      raw_cap = (size + len) * 2;
+      char *tmp = realloc(raw, raw_cap);
+      if (!tmp) {
+        err = ENOMEM;
+        break;
+      }
+      raw = tmp;
+    }
+    if (n == cap) {
+      cap = cap ? cap * 2 : 64;
+      size_t *tmp = realloc(offs, cap * sizeof(*offs));
+      if (!tmp) {
+        err = ENOMEM;
+        break;
+      }
+      offs = tmp;
+    }
+    memcpy(raw + size, e->d_name, len);
+    offs[n++] = size;
+    size += len;
+  }
+  closedir(d);
+  if (!err && (!(names = malloc((n ? n : 1) * sizeof(*names))) ||
+               !(l->names = malloc(size ? size : 1))))
+    err = ENOMEM;
+  if (!err && !(l->dir = strdup(dir)))
+    err = ENOMEM;
+  if (!err) {
+    for (int i = 0; i < n; i++)
+      names[i] = raw + offs[i];
+    qsort(names, n, sizeof(*names), cmp_names);
+    for (size_t i = 0, at = 0; i < (size_t)n; i++) {
+      size_t len = strlen(names[i]) + 1;
+      memcpy(l->names + at, names[i], len);
+      at += len;
+    }
+    l->n = n;
+    l->size = size;
+  }
+  free(raw);
+  free(offs);
+  free(names);
+  if (err)
+    drop_listing(l);
+  return err;
+}
+
+#ifdef __linux__
+// Drops the listings inotify has reported changed; called with the cache
+// locked, and never blocks
+static void drain_events(void) {
+  char buf[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  while ((len = read(notify_fd, buf, sizeof(buf))) > 0) {
+    const struct inotify_event *ev;
+    for (char *p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      for (int i = 0; i < SERVER_MAX_DIRS; i++)
+        if (listings[i].dir &&
+            (listings[i].wd == ev->wd || (ev->mask & IN_Q_OVERFLOW)))
+          drop_listing(&listings[i]);
+    }
+  }
+}
+#endif
+
+static bool listing_fresh(const listing *l) {
+  struct stat st;
+  // The watch follows the directory it was put on, which another may have
+  // replaced at this path since, say by renaming a parent
+  if (l->wd >= 0)
+    return stat(l->dir, &st) == 0 && st.st_dev == l->st.st_dev &&
+           st.st_ino == l->st.st_ino;
+  return l->st.st_mtim.tv_sec < l->read_at - RACY_SECONDS &&
+         stat(l->dir, &st) == 0 && same_file(&st, &l->st);
+}
+
+// Finds or reads the listing of dir; called with the cache locked
+static int get_listing(const char *dir, listing **out) {
+#ifdef __linux__
+  // Events still queued would otherwise wait for the accept thread, and a
+  // client that changed dir and asks again at once would get the old list
+  if (notify_fd >= 0)
+    drain_events();
+#endif
+  listing *victim = &listings[0];
+  for (int i = 0; i < SERVER_MAX_DIRS; i++) {
+    listing *l = &listings[i];
+    if (l->dir && strcmp(l->dir, dir) == 0) {
+      if (listing_fresh(l)) {
+        l->used = ++tick;
+        *out = l;
+        return 0;
+      }
+      drop_listing(l);
+    }
+    if (!l->dir ? victim->dir != NULL : victim->dir && l->used < victim->used)
+      victim = l;
+  }
+  drop_listing(victim);
+  int err = read_listing(dir, victim);
+  victim->used = ++tick;
+  *out = victim;
+  return err;
+}
+
+static void reply(int fd, int err, int n, const char *body, size_t size) {
+  char head[64];
+  int len = snprintf(head, sizeof(head), "%d %d %zu\n", err, n, size);
+  if (write_all(fd, head, len) && size)
+    write_all(fd, body, size);
+}
+
+static void serve_list(int fd, const char *dir, bool hidden) {
+  char *body = NULL;
+  size_t size = 0;
+  int n = 0;
+  listing *l;
+  pthread_mutex_lock(&cache_lock);
+  int err = get_listing(dir, &l);
+  if (!err && !(body = malloc(l->size ? l->size : 1)))
+    err = ENOMEM;
+  if (!err)
+    for (const char *p = l->names; p < l->names + l->size;) {
+      size_t len = strlen(p) + 1;
+      if (hidden || !hidden_name(p)) {
+        memcpy(body + size, p, len);
+        size += len;
+        n++;
+      }
+      p += len;
+    }
+  pthread_mutex_unlock(&cache_lock);
+  reply(fd, err, n, body, size);
+  free(body);
+}
+
+static void serve_describe(int fd, const char *path) {
+  description *d = &descriptions[hash_path(path) % SERVER_DESCRIPTIONS];
+  char text[PATH_MAX + 1024] = {0};
+  struct stat st;
+  if (lstat(path, &st) != 0) {
+    reply(fd, errno, 0, NULL, 0);
+    return;
+  }
+  pthread_mutex_lock(&cache_lock);
+  bool hit = d->path && strcmp(d->path, path) == 0 && same_file(&st, &d->st);
+  if (hit)
+    snprintf(text, sizeof(text), "%s", d->text);
+  pthread_mutex_unlock(&cache_lock);
+  if (!hit) {
+    // `file` runs unlocked; the stat taken before it keys the result
+    if (platform_describe_file(path, text, sizeof(text)) == -1) {
+      reply(fd, errno ? errno : EIO, 0, NULL, 0);
+      return;
+    }
+    size_t len = strlen(path);
+    if (strncmp(text, path, len) == 0)
+      memmove(text, text + len, strlen(text + len) + 1);
+    if (st.st_mtim.tv_sec < time(NULL) - RACY_SECONDS) {
+      char *p = strdup(path), *t = strdup(text);
+      pthread_mutex_lock(&cache_lock);
+      if (p && t) {
+        free(d->path);
+        free(d->text);
+        *d = (description){p, t, st};
+        p = t = NULL;
+      }
+      pthread_mutex_unlock(&cache_lock);
+      free(p);
+      free(t);
+    }
+  }
+  reply(fd, 0, 0, text, strlen(text));
+}
+
+static void *serve_client(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  FILE *in = fdopen(fd, "r");
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  while (in && (len = getline(&line, &cap, in)) > 0 && line[len - 1] == '\n') {
+    line[len - 1] = '\0';
+    if (line[0] == 'L' && (line[1] == '0' || line[1] == '1') &&
+        line[2] == '\t' && line[3] == '/')
+      serve_list(fd, line + 3, line[1] == '1');
+    else if (line[0] == 'D' && line[1] == '\t' && line[2] == '/')
+      serve_describe(fd, line + 2);
+    else
+      break;
+  }
+  free(line);
+  if (in)
+    fclose(in);
+  else
+    close(fd);
+  return NULL;
+}
+
+static bool same_user(int fd) {
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+         cred.uid == getuid();
+#else
+  (void)fd;
+  return true;
+#endif
+}
+
+static void stop(int signum) {
+  (void)signum;
+  stopping = 1;
+}
+
+int server_run(void) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (!socket_path(addr.sun_path, sizeof(addr.sun_path), true)) {
+    fprintf(stderr, "fex: no private directory for the server socket\n");
+    return EXIT_FAILURE;
+  }
+  int fd = unix_socket();
+  if (fd < 0) {
+    perror("socket");
+    return EXIT_FAILURE;
+  }
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    // A socket left behind by a server that died is replaced; a live one is
+    // not
+    int other = errno == EADDRINUSE ? dial(&addr) : -1;
+    if (other >= 0 || errno != ECONNREFUSED || unlink(addr.sun_path) != 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      fprintf(stderr, "fex: %s: %s\n", addr.sun_path,
+              other >= 0 ? "a server is already running" : strerror(errno));
+      if (other >= 0)
+        close(other);
+      close(fd);
+      return EXIT_FAILURE;
+    }
+  }
+  if (listen(fd, 16) != 0) {
+    perror("listen");
+    unlink(addr.sun_path);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+#ifdef __linux__
+  notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  for (int i = 0; i < SERVER_MAX_DIRS; i++)
+    listings[i].wd = -1;
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  while (!stopping) {
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {notify_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0)
+      continue;
+#ifdef __linux__
+    if (fds[1].revents & POLLIN) {
+      pthread_mutex_lock(&cache_lock);
+      drain_events();
+      pthread_mutex_unlock(&cache_lock);
+    }
+#endif
+    if (!(fds[0].revents & POLLIN))
+      continue;
+#ifdef __linux__
+    int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+#else
+    int client = accept(fd, NULL, NULL);
+    if (client >= 0)
+      platform_set_cloexec(client);
+#endif
+    if (client < 0)
+      continue;
+    pthread_t thread;
+    if (!same_user(client) ||
+        pthread_create(&thread, &attr, serve_client,
+                       (void *)(intptr_t)client) != 0)
+      close(client);
+  }
+  pthread_attr_destroy(&attr);
+  unlink(addr.sun_path);
+  close(fd);
+  return EXIT_SUCCESS;
+}
+
+bool server_connect(void) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (server_fd >= 0)
+    return true;
+  if (!socket_path(addr.sun_path, sizeof(addr.sun_path), false) ||
+      (server_fd = dial(&addr)) < 0)
+    return false;
+  struct timeval tv = {SERVER_TIMEOUT_MS / 1000,
+                       SERVER_TIMEOUT_MS % 1000 * 1000};
+  setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(server_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  if (!(server_in = fdopen(server_fd, "r"))) {
+    close(server_fd);
+    server_fd = -1;
+    return false;
+  }
+  return true;
+}
+
+void server_disconnect(void) {
+  if (server_in)
+    fclose(server_in);
+  server_in = NULL;
+  server_fd = -1;
+}
+
+// Sends a request and reads its reply into a buffer the caller frees. A
+// server error fails just this request; a broken or silent connection is
+// dropped for the rest of the session.
+static char *request(const char *kind, const char *path, int *n,
+                     size_t *size) {
+  char line[PATH_MAX + 8];
+  int err, len;
+  if (server_fd < 0 || strchr(path, '\n'))
+    return NULL;
+  len = snprintf(line, sizeof(line), "%s\t%s\n", kind, path);
+  if (len <= 0 || (size_t)len >= sizeof(line))
+    return NULL;
+  if (!write_all(server_fd, line, len) ||
+      !fgets(line, sizeof(line), server_in) ||
+      sscanf(line, "%d %d %zu", &err, n, size) != 3) {
+    server_disconnect();
+    return NULL;
+  }
+  char *body = malloc(*size + 1);
+  if (!body || fread(body, 1, *size, server_in) != *size) {
+    free(body);
+    server_disconnect();
+    return NULL;
+  }
+  body[*size] = '\0';
+  if (err) {
+    free(body);
+    return NULL;
+  }
+  return body;
+}
+
+int server_list(const char *dir, bool hidden, char ***names, int *count) {
+  int n;
+  size_t size;
+  char *body = request(hidden ? "L1" : "L0", dir, &n, &size);
+  if (!body)
+    return -1;
+  *names = malloc((n > 0 ? n : 1) * sizeof(**names));
+  *count = 0;
+  for (const char *p = body; *names && *count < n && p < body + size;) {
+    if (!((*names)[*count] = strdup(p)))
+      break;
+    p += strlen((*names)[(*count)++]) + 1;
+  }
+  free(body);
+  if (*names && *count == n)
+    return 0;
+  for (int i = 0; i < *count; i++)
+    free((*names)[i]);
+  free(*names);
+  *names = NULL;
+  *count = 0;
+  return -1;
+}
+
+int server_describe(const char *dir, const char *name, char *buf,
+                    size_t size) {
+  char path[PATH_MAX];
+  const char *sep = dir[0] && dir[strlen(dir) - 1] == '/' ? "" : "/";
+  int n, len = snprintf(path, sizeof(path), "%s%s%s", dir, sep, name);
+  size_t body_size;
+  if (len <= 0 || (size_t)len >= sizeof(path))
+    return -1;
+  char *body = request("D", path, &n, &body_size);
+  if (!body)
+    return -1;
+  snprintf(buf, size, "%s%s", name, body);
+  free(body);
+  return 0;
+}
+
+#else
+
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// There is no server on Windows; every session lists and describes for itself
+int server_run(void) {
+  fprintf(stderr, "fex: --server is not supported on this platform\n");
+  return EXIT_FAILURE;
+}
+
+bool server_connect(void) { return false; }
+
+void server_disconnect(void) {}
+
+int server_list(const char *dir, bool hidden, char ***names, int *count) {
+  (void)dir;
+  (void)hidden;
+  (void)names;
+  (void)count;
+  return -1;
+}
+
+int server_describe(const char *dir, const char *name, char *buf,
+                    size_t size) {
+  (void)dir;
+  (void)name;
+  (void)buf;
+  (void)size;
+  return -1;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// An optional per-user server, `fex_exec --server`, keeps directory listings
+// and file descriptions warm across sessions on a Unix socket under
+// $XDG_RUNTIME_DIR/fex. Listings are dropped when inotify reports a change to
+// their directory. A session that cannot reach the server, or stops hearing
+// from it, reads the filesystem itself.
+int server_run(void);
+
+bool server_connect(void);
+void server_disconnect(void);
+// Lists an absolute directory path, sorted with ".." first, into names the
+// caller frees one by one. Returns -1 when the caller should list it itself.
+int server_list(const char *, bool, char ***, int *);
+// Describes name in the absolute directory dir as `file` would. Returns -1
+// when the caller should describe it itself.
+int server_describe(const char *, const char *, char *, size_t);
+
+#endif
@@ -0,0 +1,146 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "suffix.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *sort_text;
+
+static int cmp_suffixes(const void *a, const void *b) {
+  int sa = *(const int *)a, sb = *(const int *)b;
+  // Both suffixes already share their first two bytes (see bucketing below)
+  int r = strcmp(sort_text + sa + 2, sort_text + sb + 2);
+  return r ? r : (sa > sb) - (sa < sb);
+}
+
+static int cmp_ints(const void *a, const void *b) {
+  int ia = *(const int *)a, ib = *(const int *)b;
+  return (ia > ib) - (ia < ib);
+}
+
+// Two bytes of a suffix as a bucket number. Suffixes one byte long get the
+// terminator as their second byte, which keeps them ahead of longer ones.
+static unsigned int bucket_of(const char *s) {
+  unsigned int hi = (unsigned char)s[0];
+  return (hi << 8) | (hi ? (unsigned char)s[1] : 0);
+}
+
+suffix_index *suffix_index_build(char *const names[], int n) {
+  suffix_index *idx = calloc(1, sizeof(*idx));
+  if (!idx)
+    return NULL;
+  size_t total = 0;
+  for (int i = 0; i < n; i++)
+    total += strlen(names[i]) + 1;
+  idx->n_entries = n;
+  idx->n_suffixes = (int)(total - n);
+  idx->text = malloc(total + 1);
+  idx->sa = malloc((idx->n_suffixes + 1) * sizeof(*idx->sa));
+  idx->owner = malloc((idx->n_suffixes + 1) * sizeof(*idx->owner));
+  idx->seen = calloc(n + 1, sizeof(*idx->seen));
+  int *owner_at = malloc((total + 1) * sizeof(*owner_at));
+  unsigned int *counts = calloc(65537, sizeof(*counts));
+  if (!idx->text || !idx->sa || !idx->owner || !idx->seen || !owner_at ||
+      !counts) {
+    free(owner_at);
+    free(counts);
+    suffix_index_free(idx);
+    return NULL;
+  }
+
+  size_t off = 0;
+  for (int i = 0; i < n; i++) {
+    size_t len = strlen(names[i]);
+    memcpy(idx->text + off, names[i], len + 1);
+    for (size_t j = 0; j <= len; j++)
+      owner_at[off + j] = i;
+    off += len + 1;
+  }
+
+  // Bucket the suffixes by their first two bytes, then sort each bucket
+  for (size_t p = 0; p < total; p++)
+    if (idx->text[p])
+      counts[bucket_of(idx->text + p) + 1]++;
+  for (int b = 0; b < 65536; b++)
+    counts[b + 1] += counts[b];
+  for (size_t p = 0; p < total; p++)
+    if (idx->text[p])
+      idx->sa[counts[bucket_of(idx->text + p)]++] = (int)p;
+  sort_text = idx->text;
+  for (int b = 0, first = 0; b < 65536; b++) {
+    int last = (int)counts[b];
+    if (last - first > 1 && (b & 0xff))
+      qsort(idx->sa + first, last - first, sizeof(*idx->sa), cmp_suffixes);
+    first = last;
+  }
+  for (int i = 0; i < idx->n_suffixes; i++)
+    idx->owner[i] = owner_at[idx->sa[i]];
+  free(owner_at);
+  free(counts);
+  return idx;
+}
+
+void suffix_index_free(suffix_index *idx) {
+  if (!idx)
+    return;
+  free(idx->text);
+  free(idx->sa);
+  free(idx->owner);
+  free(idx->seen);
+  free(idx);
+}
+
+// First suffix that does not sort before query, or after it when upper is
+// set, comparing only the first len bytes.
+static int bound(const suffix_index *idx, const char *query, size_t len,
+                 int upper) {
+  int lo = 0, hi = idx->n_suffixes;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    int r = strncmp(idx->text + idx->sa[mid], query, len);
+    if (r < 0 || (upper && r == 0))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Writes the entries whose name contains query to out, which must have room
+// for every entry, in listing order. The matching suffixes form one range of
+// the suffix array, so the cost depends on the number of matches rather than
+// on the size of the listing.
+int suffix_index_search(suffix_index *idx, const char *query, int *out) {
+  size_t len = strlen(query);
+  if (!len)
+    return 0;
+  int lo = bound(idx, query, len, 0), hi = bound(idx, query, len, 1), count = 0;
+  if (++idx->stamp == 0) {
+    memset(idx->seen, 0, idx->n_entries * sizeof(*idx->seen));
+    idx->stamp = 1;
+  }
+  for (int i = lo; i < hi; i++) {
+    int entry = idx->owner[i];
+    if (idx->seen[entry] != idx->stamp) {
+      idx->seen[entry] = idx->stamp;
+      out[count++] = entry;
+    }
+  }
+  qsort(out, count, sizeof(*out), cmp_ints);
+  return count;
+}
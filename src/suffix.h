@@ -0,0 +1,38 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SUFFIX_H
+#define SUFFIX_H
+
+// Suffix array over the NUL-terminated concatenation of a listing's names.
+// Every suffix stops at its name's terminator, so a query only ever matches
+// inside a single name; owner maps each suffix back to its entry.
+typedef struct suffix_index {
+  char *text;
+  int *sa;
+  int *owner;
+  unsigned int *seen;
+  unsigned int stamp;
+  int n_suffixes;
+  int n_entries;
+} suffix_index;
+
+suffix_index *suffix_index_build(char *const[], int);
+void suffix_index_free(suffix_index *);
+int suffix_index_search(suffix_index *, const char *, int *);
+
+#endif
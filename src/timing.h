@@ -0,0 +1,54 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define TIMING_MAX_MARKS 32
+
+// Named monotonic timestamps, reported relative to the first mark
+typedef struct timing_log {
+  const char *names[TIMING_MAX_MARKS];
+  long long at[TIMING_MAX_MARKS];
+  int n;
+} timing_log;
+
+static inline long long timing_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void timing_mark(timing_log *log, const char *name) {
+  if (log && log->n < TIMING_MAX_MARKS) {
+    log->names[log->n] = name;
+    log->at[log->n++] = timing_now();
+  }
+}
+
+static inline void timing_report(const timing_log *log, FILE *out) {
+  fprintf(out, "%-20s %10s %10s\n", "phase", "at ms", "took ms");
+  for (int i = 0; i < log->n; i++)
+    fprintf(out, "%-20s %10.3f %10.3f\n", log->names[i],
+            (log->at[i] - log->at[0]) / 1e6,
+            i ? (log->at[i] - log->at[i - 1]) / 1e6 : 0.0);
+}
+
+#endif
@@ -0,0 +1,328 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#include "treeindex.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Directories modified this close to the snapshot may change again within
+// the same timestamp tick, so their mtime is not trusted on the next run
+#define RACY_SECONDS 2
+
+struct tree_index {
+  const unsigned char *map;
+  size_t size;
+  const tree_index_header *header;
+  const tree_index_dir *dirs;
+  const uint32_t *slots;
+  const tree_index_entry *entries;
+  const char *strings;
+};
+
+static uint64_t hash_path(const char *s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+  return h;
+}
+
+// The fewest slots written; an index with fewer is not one of ours
+#define MIN_SLOTS 16
+
+static size_t align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+static int mkdir_parents(char *path) {
+  for (char *p = path + 1; *p; p++) {
+    if (*p != '/')
+      continue;
+    *p = '\0';
+    int r = mkdir(path, 0700);
+    *p = '/';
+    if (r != 0 && errno != EEXIST)
+      return -1;
+  }
+  return 0;
+}
+
+// Builds the index file name for a root under $XDG_CACHE_HOME/fex, creating
+// the directory if needed. The name is a hash of the root's absolute path.
+bool tree_index_path(const char *root, char *buf, size_t size) {
+  char abs[PATH_MAX];
+  if (!realpath(root, abs))
+    return false;
+  const char *cache = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+  int n;
+  if (cache && *cache == '/')
+    n = snprintf(buf, size, "%s/fex/tree-%016llx.idx", cache,
+                 (unsigned long long)hash_path(abs));
+  else if (home && *home)
+    n = snprintf(buf, size, "%s/.cache/fex/tree-%016llx.idx", home,
+                 (unsigned long long)hash_path(abs));
+  else
+    return false;
+  return n > 0 && (size_t)n < size && mkdir_parents(buf) == 0;
+}
+
+static bool valid_index(tree_index *t) {
+  const tree_index_header *h = t->header;
+  if (memcmp(h->magic, TREE_INDEX_MAGIC, 8) != 0 ||
+      h->version != TREE_INDEX_VERSION || h->n_slots < MIN_SLOTS ||
+      (h->n_slots & (h->n_slots - 1)) || h->n_dirs >= h->n_slots ||
+      !h->strings_size)
+    return false;
+  // Guard every multiplication against a corrupt header before sizing
+  size_t left = t->size - sizeof(*h);
+  if (h->n_dirs > left / sizeof(tree_index_dir))
+    return false;
+  left -= h->n_dirs * sizeof(tree_index_dir);
+  // Padded to 8 bytes, which may take more than the slots themselves left
+  if (align8((size_t)h->n_slots * sizeof(uint32_t)) > left)
+    return false;
+  left -= align8((size_t)h->n_slots * sizeof(uint32_t));
+  if (h->n_entries > left / sizeof(tree_index_entry))
+    return false;
+  left -= h->n_entries * sizeof(tree_index_entry);
+  if (h->strings_size != left)
+    return false;
+
+  t->dirs = (const tree_index_dir *)(t->map + sizeof(*h));
+  t->slots = (const uint32_t *)(t->dirs + h->n_dirs);
+  t->entries = (const tree_index_entry *)((const unsigned char *)t->slots +
+                                          align8(h->n_slots * 4));
+  t->strings = (const char *)(t->entries + h->n_entries);
+  // A terminated string table keeps every offset below it a valid string
+  if (t->strings[h->strings_size - 1] != '\0' ||
+      h->root_off >= h->strings_size)
+    return false;
+  for (uint64_t i = 0; i < h->n_dirs; i++) {
+    const tree_index_dir *d = &t->dirs[i];
+    if (d->path_off >= h->strings_size || d->first_entry > h->n_entries ||
+        d->n_entries > h->n_entries - d->first_entry)
+      return false;
+  }
+  for (uint64_t i = 0; i < h->n_entries; i++)
+    if (t->entries[i].name_off >= h->strings_size)
+      return false;
+  return true;
+}
+
+// Maps the index in file if it exists, is well formed, and was taken of the
+// same root. Returns NULL otherwise; the caller then walks from scratch.
+tree_index *tree_index_open(const char *file, const char *root) {
+  char abs[PATH_MAX];
+  if (!realpath(root, abs))
+    return NULL;
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  tree_index *t = NULL;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(tree_index_header) &&
+      (t = calloc(1, sizeof(*t)))) {
+    t->size = st.st_size;
+    void *map = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    t->map = map == MAP_FAILED ? NULL : map;
+    t->header = (const tree_index_header *)t->map;
+  }
+  close(fd);
+  if (t && t->map && valid_index(t) &&
+      strcmp(t->strings + t->header->root_off, abs) == 0)
+    return t;
+  tree_index_close(t);
+  return NULL;
+}
+
+void tree_index_close(tree_index *t) {
+  if (!t)
+    return;
+  if (t->map)
+    munmap((void *)t->map, t->size);
+  free(t);
+}
+
+// Finds the directory at path (relative to the root) if its listing is still
+// current, that is the directory is the same inode with the same mtime.
+const tree_index_dir *tree_index_lookup(const tree_index *t, const char *path,
+                                        const struct stat *st) {
+  uint32_t mask = t->header->n_slots - 1, h = hash_path(path) & mask;
+  // A table written whole has an empty slot to stop at; a corrupt one may
+  // not, so the probe never goes round more than once
+  for (uint32_t i = 0; i < t->header->n_slots; i++, h = (h + 1) & mask) {
+    uint32_t slot = t->slots[h];
+    if (!slot || slot > t->header->n_dirs)
+      return NULL;
+    const tree_index_dir *d = &t->dirs[slot - 1];
+    if (strcmp(t->strings + d->path_off, path) != 0)
+      continue;
+    if (d->ino != (uint64_t)st->st_ino || d->dev != (uint64_t)st->st_dev ||
+        d->mtime_sec != (int64_t)st->st_mtim.tv_sec ||
+        d->mtime_nsec != (int64_t)st->st_mtim.tv_nsec)
+      return NULL;
+    return d;
+  }
+  return NULL;
+}
+
+const tree_index_entry *tree_index_entries(const tree_index *t,
+                                           const tree_index_dir *d) {
+  return t->entries + d->first_entry;
+}
+
+const char *tree_index_strings(const tree_index *t) { return t->strings; }
+
+static uint64_t add_string(tree_index_builder *b, const char *s) {
+  size_t len = strlen(s) + 1;
+  if (b->strings_size + len > b->cap_strings) {
+    size_t cap = b->cap_strings ? b->cap_strings * 2 : 64 * 1024;
+    while (cap < b->strings_size + len)
+      cap *= 2;
+    char *tmp = realloc(b->strings, cap);
+    if (!tmp)
+      return UINT64_MAX;
+    b->strings = tmp;
+    b->cap_strings = cap;
+  }
+  memcpy(b->strings + b->strings_size, s, len);
+  b->strings_size += len;
+  return b->strings_size - len;
+}
+
+// Records the listing of the directory at path. Entry names are offsets into
+// names, which may be a mapped index's string table or a caller's buffer.
+bool tree_index_add_dir(tree_index_builder *b, const char *path,
+                        const struct stat *st, const tree_index_entry *ents,
+                        uint32_t n, const char *names) {
+  if (b->n_dirs == b->cap_dirs) {
+    size_t cap = b->cap_dirs ? b->cap_dirs * 2 : 256;
+    tree_index_dir *tmp = realloc(b->dirs, cap * sizeof(*tmp));
+    if (!tmp)
+      return false;
+    b->dirs = tmp;
+    b->cap_dirs = cap;
+  }
+  if (b->n_entries + n > b->cap_entries) {
+    size_t cap = b->cap_entries ? b->cap_entries * 2 : 4096;
+    while (cap < b->n_entries + n)
+      cap *= 2;
+    tree_index_entry *tmp = realloc(b->entries, cap * sizeof(*tmp));
+    if (!tmp)
+      return false;
+    b->entries = tmp;
+    b->cap_entries = cap;
+  }
+  tree_index_dir d = {.ino = st->st_ino,
+                      .dev = st->st_dev,
+                      .mtime_sec = st->st_mtim.tv_sec,
+                      .mtime_nsec = st->st_mtim.tv_nsec,
+                      .first_entry = b->n_entries,
+                      .n_entries = n};
+  if (time(NULL) - st->st_mtim.tv_sec < RACY_SECONDS)
+    d.mtime_sec = -1;
+  if ((d.path_off = add_string(b, path)) == UINT64_MAX)
+    return false;
+  for (uint32_t i = 0; i < n; i++) {
+    tree_index_entry e = ents[i];
+    if ((e.name_off = add_string(b, names + ents[i].name_off)) == UINT64_MAX)
+      return false;
+    b->entries[b->n_entries++] = e;
+  }
+  b->dirs[b->n_dirs++] = d;
+  return true;
+}
+
+// Writes the collected listings for root to file, replacing it atomically so
+// a concurrent reader maps either the old index or the new one.
+bool tree_index_write(const tree_index_builder *b, const char *root,
+                      const char *file) {
+  char abs[PATH_MAX], tmp[PATH_MAX + 32];
+  if (!b->n_dirs || !realpath(root, abs) ||
+      snprintf(tmp, sizeof(tmp), "%s.%ld", file, (long)getpid()) >=
+          (int)sizeof(tmp))
+    return false;
+  uint32_t n_slots = MIN_SLOTS;
+  while (n_slots < b->n_dirs * 2)
+    n_slots *= 2;
+  uint32_t *slots = calloc(align8(n_slots * sizeof(*slots)), 1);
+  if (!slots)
+    return false;
+  for (size_t i = 0; i < b->n_dirs; i++) {
+    uint32_t h = hash_path(b->strings + b->dirs[i].path_off) & (n_slots - 1);
+    while (slots[h])
+      h = (h + 1) & (n_slots - 1);
+    slots[h] = i + 1;
+  }
+  size_t root_len = strlen(abs) + 1;
+  tree_index_header h = {.version = TREE_INDEX_VERSION,
+                         .n_slots = n_slots,
+                         .n_dirs = b->n_dirs,
+                         .n_entries = b->n_entries,
+                         .strings_size = b->strings_size + root_len,
+                         .root_off = b->strings_size};
+  memcpy(h.magic, TREE_INDEX_MAGIC, 8);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  if (!f) {
+    if (fd >= 0)
+      close(fd);
+    free(slots);
+    return false;
+  }
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(b->dirs, sizeof(*b->dirs), b->n_dirs, f) == b->n_dirs &&
+            fwrite(slots, align8(n_slots * sizeof(*slots)), 1, f) == 1 &&
+            fwrite(b->entries, sizeof(*b->entries), b->n_entries, f) ==
+                b->n_entries &&
+            fwrite(b->strings, 1, b->strings_size, f) == b->strings_size &&
+            fwrite(abs, 1, root_len, f) == root_len;
+  ok = fclose(f) == 0 && ok;
+  free(slots);
+  if (ok && rename(tmp, file) == 0)
+    return true;
+  unlink(tmp);
+  return false;
+}
+
+void tree_index_builder_free(tree_index_builder *b) {
+  free(b->dirs);
+  free(b->entries);
+  free(b->strings);
+  *b = (tree_index_builder){0};
+}
+
+#else
+
+#include "treeindex.h"
+
+// Recursive find is not implemented on Windows, so no tree index is kept
+bool tree_index_path(const char *root, char *buf, size_t size) {
+  (void)root;
+  (void)buf;
+  (void)size;
+  return false;
+}
+
+#endif
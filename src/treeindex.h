@@ -0,0 +1,86 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TREEINDEX_H
+#define TREEINDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// On-disk snapshot of the directories a walk has read. The file is mapped
+// read-only and used in place: every reference is an offset, so nothing is
+// fixed up after mmap. Layout, all fields native-endian and 8-byte aligned:
+//
+//   tree_index_header
+//   tree_index_dir    dirs[n_dirs]     in walk order, found via slots
+//   uint32_t          slots[n_slots]   open-addressed path hash, dir + 1
+//   tree_index_entry  entries[n_entries]
+//   char              strings[strings_size]
+#define TREE_INDEX_MAGIC "FEXTIDX1"
+#define TREE_INDEX_VERSION 1
+
+enum tree_kind { TREE_FILE, TREE_DIR, TREE_LINK, TREE_OTHER };
+
+typedef struct tree_index_header {
+  char magic[8];
+  uint32_t version, n_slots;
+  uint64_t n_dirs, n_entries, strings_size;
+  uint64_t root_off; // absolute path of the walk root
+} tree_index_header;
+
+// A directory relative to the root and its listing as of mtime. Entries are
+// raw, before hidden or ignore filtering, so one index serves every option.
+typedef struct tree_index_dir {
+  uint64_t ino, dev;
+  int64_t mtime_sec, mtime_nsec;
+  uint64_t path_off, first_entry;
+  uint32_t n_entries, pad;
+} tree_index_dir;
+
+typedef struct tree_index_entry {
+  uint64_t ino, name_off;
+  uint32_t kind, pad;
+} tree_index_entry;
+
+typedef struct tree_index tree_index;
+
+// Directory listings collected during a walk, to be written out as an index
+typedef struct tree_index_builder {
+  tree_index_dir *dirs;
+  tree_index_entry *entries;
+  char *strings;
+  size_t n_dirs, cap_dirs, n_entries, cap_entries, strings_size, cap_strings;
+} tree_index_builder;
+
+bool tree_index_path(const char *, char *, size_t);
+tree_index *tree_index_open(const char *, const char *);
+void tree_index_close(tree_index *);
+const tree_index_dir *tree_index_lookup(const tree_index *, const char *,
+                                        const struct stat *);
+const tree_index_entry *tree_index_entries(const tree_index *,
+                                           const tree_index_dir *);
+const char *tree_index_strings(const tree_index *);
+
+bool tree_index_add_dir(tree_index_builder *, const char *,
+                        const struct stat *, const tree_index_entry *,
+                        uint32_t, const char *);
+bool tree_index_write(const tree_index_builder *, const char *, const char *);
+void tree_index_builder_free(tree_index_builder *);
+
+#endif
@@ -16,84 +16,355 @@ You should have received a copy of the GNU General Public License
 along with fex.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "trie.h"
+#include "filter.h"
+#include "fold.h"
+#include "fuzzy.h"
+#include "match.h"
+#include "suffix.h"
 #include <ncurses.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
-trie_node *create_trie_node(void) {
-  trie_node *node = malloc(sizeof(trie_node));
+static trie_node *new_trie_node(const char *label, unsigned int len) {
+  trie_node *node = malloc(sizeof(trie_node) + len);
   if (node) {
-    node->is_end_of_word = false;
+    node->children = NULL;
     node->index = -1;
-    for (int i = 0; i < ALPHABET_SIZE; i++)
-      node->children[i] = NULL;
+    node->n_words = 0;
+    node->label_len = len;
+    node->n_children = node->cap_children = 0;
+    node->is_end_of_word = false;
+    memcpy(node->label, label, len);
   }
   return node;
 }
 
+trie_node *create_trie_node(void) { return new_trie_node("", 0); }
+
+// Binary search for the child whose label starts with c. When there is none,
+// *pos is set to the slot where such a child has to be inserted.
+static trie_node *find_child(const trie_node *node, unsigned char c,
+                             int *pos) {
+  int lo = 0, hi = node->n_children;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    unsigned char m = (unsigned char)node->children[mid]->label[0];
+    if (m == c) {
+      *pos = mid;
+      return node->children[mid];
+    }
+    if (m < c)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *pos = lo;
+  return NULL;
+}
+
+static bool add_child(trie_node *node, int pos, trie_node *child) {
+  if (node->n_children == node->cap_children) {
+    unsigned short cap = node->cap_children ? node->cap_children * 2 : 2;
+    trie_node **tmp = realloc(node->children, cap * sizeof(*tmp));
+    if (!tmp)
+      return false;
+    node->children = tmp;
+    node->cap_children = cap;
+  }
+  memmove(node->children + pos + 1, node->children + pos,
+          (node->n_children - pos) * sizeof(*node->children));
+  node->children[pos] = child;
+  node->n_children++;
+  return true;
+}
+
 void insert_trie(trie_node *root, const char *word, int index) {
-  trie_node *cur = root;
-  for (int i = 0; word[i]; i++) {
-    int idx = (int)word[i];
-    if (idx < 0 || idx >= ALPHABET_SIZE)
-      continue;
-    if (!cur->children[idx])
-      cur->children[idx] = create_trie_node();
-    cur = cur->children[idx];
+  unsigned int rem = (unsigned int)strnlen(word, BUFSIZE);
+  trie_node *cur = root, *path[BUFSIZE + 1];
+  int depth = 0;
+  const char *k = word;
+  path[depth++] = root;
+  while (rem) {
+    int pos;
+    trie_node *child = find_child(cur, (unsigned char)*k, &pos);
+    if (!child) {
+      trie_node *leaf = new_trie_node(k, rem);
+      if (!leaf)
+        return;
+      if (!add_child(cur, pos, leaf)) {
+        free(leaf);
+        return;
+      }
+      cur = leaf;
+      path[depth++] = cur;
+      break;
+    }
+    unsigned int common = 0;
+    while (common < child->label_len && common < rem &&
+           child->label[common] == k[common])
+      common++;
+    if (common < child->label_len) {
+      // The key diverges inside this edge: split it at the divergence point
+      trie_node *mid = new_trie_node(child->label, common);
+      if (!mid)
+        return;
+      mid->children = malloc(2 * sizeof(*mid->children));
+      if (!mid->children) {
+        free(mid);
+        return;
+      }
+      mid->cap_children = 2;
+      memmove(child->label, child->label + common, child->label_len - common);
+      child->label_len -= common;
+      mid->children[0] = child;
+      mid->n_children = 1;
+      mid->n_words = child->n_words;
+      cur->children[pos] = mid;
+      child = mid;
+    }
+    cur = child;
+    path[depth++] = cur;
+    k += common;
+    rem -= common;
   }
+  if (!cur->is_end_of_word)
+    while (depth)
+      path[--depth]->n_words++;
   cur->is_end_of_word = true;
   cur->index = index;
 }
 
+// Returns the node whose subtree holds every word starting with prefix. When
+// the prefix ends halfway through an edge, that edge's node is returned.
 trie_node *search_trie_prefix(trie_node *root, const char *prefix) {
   trie_node *cur = root;
-  for (int i = 0; prefix[i]; i++) {
-    int idx = (int)prefix[i];
-    if (idx < 0 || idx >= ALPHABET_SIZE)
+  while (*prefix) {
+    int pos;
+    trie_node *child = find_child(cur, (unsigned char)*prefix, &pos);
+    if (!child)
       return NULL;
-    if (!cur->children[idx])
-      return NULL;
-    cur = cur->children[idx];
+    for (unsigned int i = 0; i < child->label_len && *prefix; i++, prefix++)
+      if (child->label[i] != *prefix)
+        return NULL;
+    cur = child;
   }
   return cur;
 }
 
-void collect_trie_indices(trie_node *node, int *indices, int *count,
-                          int max_count) {
-  if (!node || *count >= max_count)
+// Positions the iterator on the skip-th word (in byte order) of node's
+// subtree. Whole subtrees in front of it are stepped over using their word
+// counts, so seeking costs one pass down the tree rather than a walk.
+void trie_iter_seek(trie_iter *it, trie_node *node, unsigned int skip) {
+  it->depth = 0;
+  if (!node || skip >= node->n_words)
     return;
-  if (node->is_end_of_word) {
-    indices[*count] = node->index;
-    (*count)++;
+  it->stack[it->depth++] = (trie_frame){node, -1};
+  while (1) {
+    trie_frame *top = &it->stack[it->depth - 1];
+    if (node->is_end_of_word) {
+      if (skip == 0)
+        return;
+      skip--;
+    }
+    int i = 0;
+    for (; i < node->n_children && skip >= node->children[i]->n_words; i++)
+      skip -= node->children[i]->n_words;
+    top->child = i + 1;
+    node = node->children[i];
+    it->stack[it->depth++] = (trie_frame){node, -1};
+  }
+}
+
+// Returns the index of the next word, or -1 once the subtree is exhausted.
+int trie_iter_next(trie_iter *it) {
+  while (it->depth > 0) {
+    trie_frame *top = &it->stack[it->depth - 1];
+    if (top->child < 0) {
+      top->child = 0;
+      if (top->node->is_end_of_word)
+        return top->node->index;
+    } else if (top->child < top->node->n_children) {
+      trie_node *next = top->node->children[top->child++];
+      it->stack[it->depth++] = (trie_frame){next, -1};
+    } else
+      it->depth--;
   }
-  for (int i = 0; i < ALPHABET_SIZE; i++)
-    if (node->children[i])
-      collect_trie_indices(node->children[i], indices, count, max_count);
+  return -1;
+}
+
+void collect_trie_indices(trie_node *node, int *indices, int *count,
+                          int max_count) {
+  trie_iter it;
+  trie_iter_seek(&it, node, 0);
+  int index;
+  while (*count < max_count && (index = trie_iter_next(&it)) >= 0)
+    indices[(*count)++] = index;
 }
 
 void free_trie(trie_node *node) {
   if (!node)
     return;
-  for (int i = 0; i < ALPHABET_SIZE; i++)
-    if (node->children[i])
-      free_trie(node->children[i]);
+  for (int i = 0; i < node->n_children; i++)
+    free_trie(node->children[i]);
+  free(node->children);
   free(node);
 }
 
+void search_index_sync(search_index *idx, int n_choices, char *choices[]) {
+  if (n_choices < idx->n_indexed)
+    search_index_free(idx);
+  if (n_choices == idx->n_indexed)
+    return;
+  char **tmp = realloc(idx->folded, (n_choices + 1) * sizeof(*tmp));
+  if (!tmp)
+    return;
+  idx->folded = tmp;
+  int n = idx->n_indexed;
+  for (; n < n_choices; n++) {
+    if (!(idx->folded[n] = fold_dup(choices[n])))
+      break;
+    for (int f = 0; f < 2; f++)
+      if (idx->tries[f])
+        insert_trie(idx->tries[f], f ? idx->folded[n] : choices[n], n);
+  }
+  for (int f = 0; f < 2; f++) {
+    suffix_index_free(idx->substr[f]);
+    idx->substr[f] = NULL;
+  }
+  idx->n_indexed = n;
+}
+
+void search_index_free(search_index *idx) {
+  for (int i = 0; i < idx->n_indexed; i++)
+    free(idx->folded[i]);
+  free(idx->folded);
+  idx->folded = NULL;
+  for (int f = 0; f < 2; f++) {
+    free_trie(idx->tries[f]);
+    suffix_index_free(idx->substr[f]);
+    idx->tries[f] = NULL;
+    idx->substr[f] = NULL;
+  }
+  idx->n_indexed = 0;
+}
+
+static trie_node *index_trie(search_index *idx, int folded, char *choices[]) {
+  if (!idx->tries[folded] && (idx->tries[folded] = create_trie_node()))
+    for (int i = 0; i < idx->n_indexed; i++)
+      insert_trie(idx->tries[folded], folded ? idx->folded[i] : choices[i], i);
+  return idx->tries[folded];
+}
+
+static suffix_index *index_substr(search_index *idx, int folded,
+                                  char *choices[]) {
+  if (!idx->substr[folded])
+    idx->substr[folded] = suffix_index_build(
+        folded ? idx->folded : choices, idx->n_indexed);
+  return idx->substr[folded];
+}
+
+// One entry per query length: the node whose subtree holds the matches and
+// how far into its edge the query reaches.
+typedef struct search_level {
+  trie_node *node;
+  unsigned int offset;
+} search_level;
+
+static void search_step(const search_level *from, char ch, search_level *to) {
+  *to = *from;
+  trie_node *node = from->node;
+  int pos;
+  if (!node)
+    return;
+  if (from->offset < node->label_len) {
+    // Still inside the same edge: the match set does not change
+    if (node->label[from->offset] == ch)
+      to->offset++;
+    else
+      to->node = NULL;
+    return;
+  }
+  to->node = find_child(node, (unsigned char)ch, &pos);
+  to->offset = 1;
+}
+
+static int n_digits(int n) {
+  int ret = 1;
+  while (n /= 10)
+    ++ret;
+  return ret;
+}
+
+typedef enum {
+  SEARCH_PREFIX,
+  SEARCH_FUZZY,
+  SEARCH_SUBSTRING,
+  SEARCH_REGEX,
+  SEARCH_N_MODES
+} search_mode;
+
+static const char *const search_mode_tags[SEARCH_N_MODES] = {
+    "", "fuzzy", "substr", "regex"};
+
+#define MATCH_POLL_MS 1
+
+// Waits for the executor while still reading keys. A key cancels the query
+// in flight and is pushed back for the caller to handle; returns false then.
+static bool await_match(WINDOW *menu_win, match_exec *ex) {
+  bool done = true;
+  wtimeout(menu_win, MATCH_POLL_MS);
+  while (!match_poll(ex)) {
+    int c = wgetch(menu_win);
+    if (c != ERR) {
+      match_cancel(ex);
+      ungetch(c);
+      done = false;
+      break;
+    }
+  }
+  wtimeout(menu_win, -1);
+  return done;
+}
+
 void handle_search(WINDOW *menu_win, int *highlight, int n_choices,
-                   char *choices[]) {
-  trie_node *root = create_trie_node();
-  for (int i = 0; i < n_choices; i++)
-    insert_trie(root, choices[i], i);
-  char query[BUFSIZE] = {0};
-  int pos = 0, c, selected_match = 0, match_count = 0, indices[BUFSIZE] = {0};
+                   char *choices[], search_index *idx) {
+  search_index_sync(idx, n_choices, choices);
+  n_choices = idx->n_indexed;
+  // key is the query as looked up: folded unless it needs an exact case
+  // match. The level stack is valid for the first depth bytes of built.
+  char query[BUFSIZE] = {0}, key[BUFSIZE], built[BUFSIZE];
+  int pos = 0, c, selected_match = 0, match_count = 0, depth = 0;
+  search_level levels[BUFSIZE];
+  search_mode mode = SEARCH_PREFIX;
+  // The executor holds the fuzzy matches for the query prefix of length
+  // fuzzy_len (a longer query with the same case sensitivity only has to
+  // rescore those) and the regex matches for the pattern in filtered, so
+  // moving the selection does not run either again
+  match_exec ex;
+  bool have_exec = false, fuzzy_sensitive = false, filter_ok = false;
+  int fuzzy_len = -1, total_count = 0, *substr = NULL;
+  char filtered[BUFSIZE] = {0}, filter_err[128] = {0};
   const int visible_count = 5;
+  int page[visible_count];
+  levels[0] = (search_level){NULL, 0};
   mvprintw(LINES - 1, 0, "/");
   refresh();
   while ((c = wgetch(menu_win)) != '\n' && c != 27) {
     if ((c == KEY_BACKSPACE || c == 127) && pos > 0) {
       pos--;
       query[pos] = '\0';
+      if (fuzzy_len > pos)
+        fuzzy_len = -1;
+    } else if (c == '\t') {
+      mode = (mode + 1) % SEARCH_N_MODES;
+      selected_match = 0;
+      filtered[0] = '\0';
+    } else if (c == '/' && pos == 0) {
+      // Names never contain a slash, so a leading one switches to regex
+      mode = SEARCH_REGEX;
+      selected_match = 0;
+      filtered[0] = '\0';
     } else if (c != '\n' && pos < (int)sizeof(query) - 1 && c != KEY_UP &&
                c != KEY_DOWN) {
       query[pos++] = (char)c;
@@ -107,7 +378,7 @@ void handle_search(WINDOW *menu_win, int *highlight, int n_choices,
           selected_match = (selected_match + 1) % match_count;
       }
     }
-    mvprintw(LINES - 1, 0, "/%s", query);
+    mvprintw(LINES - 1, 0, "%s/%s", search_mode_tags[mode], query);
     clrtoeol();
     refresh();
 
@@ -120,35 +391,119 @@ void handle_search(WINDOW *menu_win, int *highlight, int n_choices,
       refresh();
       continue;
     }
-    trie_node *node = search_trie_prefix(root, query);
+    const int *matches = NULL;
+    bool sensitive = fold_utf8(query, key);
+    if (sensitive)
+      memcpy(key, query, pos + 1);
     match_count = 0;
-    if (node)
-      collect_trie_indices(node, indices, &match_count, BUFSIZE);
+    if (mode == SEARCH_PREFIX) {
+      trie_node *trie = index_trie(idx, !sensitive, choices);
+      if (!trie)
+        break;
+      if (trie != levels[0].node) {
+        levels[0] = (search_level){trie, 0};
+        depth = 0;
+      }
+      // Keep the levels shared with the previous key, so typing a character
+      // takes one step down and backspace just pops
+      int common = 0;
+      while (common < depth && common < pos && built[common] == key[common])
+        common++;
+      for (depth = common; depth < pos; depth++) {
+        search_step(&levels[depth], key[depth], &levels[depth + 1]);
+        built[depth] = key[depth];
+      }
+      // Exact count from the subtree; rows are produced for the window below
+      if (levels[pos].node)
+        match_count = (int)levels[pos].node->n_words;
+    } else if (mode == SEARCH_SUBSTRING) {
+      suffix_index *sa = index_substr(idx, !sensitive, choices);
+      if (!sa)
+        break;
+      if (!substr && !(substr = malloc((n_choices + 1) * sizeof(*substr))))
+        break;
+      match_count = suffix_index_search(sa, key, substr);
+      matches = substr;
+    } else {
+      if (!have_exec && !(have_exec = match_exec_init(&ex, n_choices)))
+        break;
+      if (mode == SEARCH_REGEX) {
+        if (strcmp(filtered, query) != 0) {
+          regex_entry *re = regex_cache_get(query, !sensitive, filter_err,
+                                            sizeof(filter_err));
+          memcpy(filtered, query, pos + 1);
+          if ((filter_ok = re != NULL)) {
+            match_regex(&ex, choices, n_choices, re);
+            if (!await_match(menu_win, &ex)) {
+              filtered[0] = '\0';
+              continue;
+            }
+          }
+        }
+        match_count = filter_ok ? ex.n_hits : 0;
+        matches = ex.hits;
+      } else {
+        if (pos != fuzzy_len) {
+          fuzzy_pattern pat;
+          fuzzy_compile(&pat, query);
+          match_fuzzy(&ex, choices, idx->folded, n_choices, &pat,
+                      pos > fuzzy_len && fuzzy_len > 0 &&
+                          pat.case_sensitive == fuzzy_sensitive);
+          fuzzy_sensitive = pat.case_sensitive;
+          fuzzy_len = pos;
+          if (!await_match(menu_win, &ex)) {
+            fuzzy_len = -1;
+            continue;
+          }
+        }
+        // Only the best matches are ranked, so only those can be selected
+        match_count = ex.n_top;
+        total_count = ex.n_set;
+      }
+    }
+    if (mode != SEARCH_FUZZY)
+      total_count = match_count;
     if (match_count > 0) {
       if (selected_match >= match_count)
         selected_match = 0;
       int first_index = (match_count <= visible_count)
                             ? 0
                             : (selected_match - visible_count / 2);
+      if (first_index > match_count - visible_count)
+        first_index = match_count - visible_count;
       if (first_index < 0)
         first_index = 0;
-      else if (first_index > match_count - visible_count)
-        first_index = match_count - visible_count;
-      for (int i = first_index;
-           i < first_index + visible_count && i < match_count; i++) {
-        if (i == selected_match)
+      int n_rows = match_count - first_index;
+      if (n_rows > visible_count)
+        n_rows = visible_count;
+      if (mode == SEARCH_PREFIX) {
+        trie_iter it;
+        trie_iter_seek(&it, levels[pos].node, (unsigned int)first_index);
+        for (int i = 0; i < n_rows; i++)
+          page[i] = trie_iter_next(&it);
+      } else
+        for (int i = 0; i < n_rows; i++)
+          page[i] = matches ? matches[first_index + i]
+                            : ex.top[first_index + i].index;
+      for (int i = 0; i < n_rows; i++) {
+        if (first_index + i == selected_match)
           attron(A_REVERSE);
-        mvprintw(LINES - (visible_count + 1) + (i - first_index), 0, "%s",
-                 choices[indices[i]]);
-        if (i == selected_match)
+        mvprintw(LINES - (visible_count + 1) + i, 0, "%s", choices[page[i]]);
+        if (first_index + i == selected_match)
           attroff(A_REVERSE);
       }
-      *highlight = indices[selected_match] + 1;
-    } else
+      *highlight = page[selected_match - first_index] + 1;
+      mvprintw(LINES - 1, COLS - n_digits(total_count) * 2 - 2, "%d/%d",
+               selected_match + 1, total_count);
+    } else if (mode == SEARCH_REGEX && !filter_ok)
+      mvprintw(LINES - (visible_count + 1), 0, "Bad pattern: %s", filter_err);
+    else
       mvprintw(LINES - (visible_count + 1), 0, "No matches");
     refresh();
   }
-  free_trie(root);
+  if (have_exec)
+    match_exec_free(&ex);
+  free(substr);
   move(LINES - 1, 0);
   clrtoeol();
   for (int i = LINES - (visible_count + 1); i < LINES - 1; i++) {
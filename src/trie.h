@@ -18,24 +18,62 @@ along with fex.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef TRIE_H
 #define TRIE_H
 
-#define ALPHABET_SIZE 128
 #ifndef BUFSIZE
 #define BUFSIZE 1024
 
 #include <ncurses.h>
 #endif
 
+// Path-compressed radix tree over raw bytes, so UTF-8 names are indexed as
+// they are. Every node stores the edge label leading to it inline and keeps
+// its children in a small array sorted by the first byte of their label, so
+// a node costs a few dozen bytes however large the alphabet. n_words counts
+// the words stored in the node's subtree.
 typedef struct trie_node {
-  struct trie_node *children[ALPHABET_SIZE];
-  bool is_end_of_word;
+  struct trie_node **children;
   int index;
+  unsigned int n_words;
+  unsigned int label_len;
+  unsigned short n_children, cap_children;
+  bool is_end_of_word;
+  char label[];
 } trie_node;
 
+// Non-recursive cursor over a subtree's words, in byte order.
+typedef struct trie_frame {
+  trie_node *node;
+  int child;
+} trie_frame;
+
+typedef struct trie_iter {
+  trie_frame stack[BUFSIZE + 1];
+  int depth;
+} trie_iter;
+
+// Search index kept alongside a directory listing. Every entry's case-folded
+// name is computed once, when the entry is first indexed, and each lookup
+// structure exists in two flavours: [0] over the names as they are, for
+// queries that need an exact case match, and [1] over the folded names. The
+// tries are built lazily on the first search that needs them and only
+// entries added since then are inserted later, so reopening the overlay
+// costs nothing. The suffix arrays behind substring mode are only built the
+// first time that mode is used.
+typedef struct search_index {
+  char **folded;
+  trie_node *tries[2];
+  struct suffix_index *substr[2];
+  int n_indexed;
+} search_index;
+
 trie_node *create_trie_node(void);
 void insert_trie(trie_node *, const char *, int);
 trie_node *search_trie_prefix(trie_node *, const char *);
+void trie_iter_seek(trie_iter *, trie_node *, unsigned int);
+int trie_iter_next(trie_iter *);
 void collect_trie_indices(trie_node *, int *, int *, int);
 void free_trie(trie_node *);
-void handle_search(WINDOW *, int *, int, char *[]);
+void search_index_sync(search_index *, int, char *[]);
+void search_index_free(search_index *);
+void handle_search(WINDOW *, int *, int, char *[], search_index *);
 
 #endif
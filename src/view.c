@@ -0,0 +1,374 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+#define _GNU_SOURCE // memrchr, memmem
+#include "view.h"
+#include "lines.h"
+#include <fcntl.h>
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MARK_LINES 1024
+// Scans of the file go in steps this large, showing progress and stopping
+// at a key press between them; scrolling indexes at most one step on its own
+#define STEP (16 << 20)
+#define MAX_QUERY 256
+
+typedef struct viewer {
+  const char *name;
+  const char *data;
+  size_t size;
+  // Line starts about MARK_LINES lines apart, over the first `indexed`
+  // bytes, in order
+  line_mark *marks;
+  size_t n_marks, cap_marks;
+  size_t indexed, indexed_lines;
+  size_t top; // where the first line on screen starts
+  char query[MAX_QUERY];
+  const char *message;
+} viewer;
+
+// Pages already scanned are dropped from the mapping: they stay in the page
+// cache, but resident memory is bounded by one step however far the scan
+// goes
+static void release(const viewer *v, size_t from, size_t to) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  from = (from + page - 1) & ~(page - 1);
+  to &= ~(page - 1);
+  if (to > from)
+    madvise((void *)(v->data + from), to - from, MADV_DONTNEED);
+}
+
+// Extends the index to cover the first `to` bytes
+static bool index_to(viewer *v, size_t to) {
+  if (to > v->size)
+    to = v->size;
+  if (to <= v->indexed)
+    return true;
+  size_t n = lines_index(v->data, v->indexed, to, v->indexed_lines,
+                         MARK_LINES, &v->marks, &v->n_marks, &v->cap_marks);
+  if (n == (size_t)-1)
+    return false;
+  release(v, v->indexed, to);
+  v->indexed = to;
+  v->indexed_lines += n;
+  return true;
+}
+
+static bool key_pressed(void) {
+  nodelay(stdscr, TRUE);
+  int c = getch();
+  nodelay(stdscr, FALSE);
+  return c != ERR;
+}
+
+static void progress(const char *what, size_t done, size_t total) {
+  mvprintw(LINES - 1, 0, "%s %d%% (any key stops)", what,
+           total ? (int)(done * 100 / total) : 100);
+  clrtoeol();
+  refresh();
+}
+
+static size_t next_line(const viewer *v, size_t off) {
+  const char *p = memchr(v->data + off, '\n', v->size - off);
+  return p ? (size_t)(p - v->data) + 1 : v->size;
+}
+
+static size_t line_start(const viewer *v, size_t off) {
+  const char *p = off ? memrchr(v->data, '\n', off) : NULL;
+  return p ? (size_t)(p - v->data) + 1 : 0;
+}
+
+static size_t prev_line(const viewer *v, size_t off) {
+  return off ? line_start(v, off - 1) : 0;
+}
+
+static int rows(void) { return LINES > 1 ? LINES - 1 : 1; }
+
+// The lowest top there is: the last line at the bottom of the screen
+static size_t last_top(const viewer *v) {
+  size_t top = v->size;
+  if (top && v->data[top - 1] == '\n')
+    top--;
+  top = line_start(v, top);
+  for (int i = 1; i < rows() && top; i++)
+    top = prev_line(v, top);
+  return top;
+}
+
+// The last mark at or before a line start (by_line) or an offset
+static const line_mark *mark_before(const viewer *v, size_t key,
+                                    bool by_line) {
+  size_t lo = 0, hi = v->n_marks;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if ((by_line ? v->marks[mid].line : v->marks[mid].offset) <= key)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return &v->marks[lo];
+}
+
+// Line number, from 0, of the line starting at off within the index
+static size_t line_of(const viewer *v, size_t off) {
+  const line_mark *m = mark_before(v, off, false);
+  return m->line + lines_count(v->data + m->offset, off - m->offset);
+}
+
+// Start of line n, from 0, indexing as far as it takes; SIZE_MAX when
+// stopped by a key
+static size_t find_line(viewer *v, size_t n) {
+  while (v->indexed_lines < n && v->indexed < v->size) {
+    progress("Indexing", v->indexed, v->size);
+    if (!index_to(v, v->indexed + STEP) || key_pressed())
+      return SIZE_MAX;
+  }
+  if (n > v->indexed_lines)
+    return last_top(v);
+  const line_mark *m = mark_before(v, n, true);
+  size_t left = n - m->line;
+  return m->offset + lines_skip(v->data + m->offset, v->size - m->offset,
+                                &left);
+}
+
+// First match of the query after the top line; SIZE_MAX when there is none
+// or a key stopped the search
+static size_t search(viewer *v) {
+  size_t len = strlen(v->query), from = next_line(v, v->top);
+  while (len && from < v->size) {
+    size_t to = from + STEP < v->size ? from + STEP : v->size;
+    // Each step reaches into the next so a match across the seam is found
+    size_t reach = to + len - 1 < v->size ? to + len - 1 : v->size;
+    const char *p = memmem(v->data + from, reach - from, v->query, len);
+    if (p)
+      return line_start(v, p - v->data);
+    release(v, from, to);
+    from = to;
+    if (from < v->size) {
+      progress("Searching", from, v->size);
+      if (key_pressed())
+        return SIZE_MAX;
+    }
+  }
+  v->message = "Pattern not found";
+  return SIZE_MAX;
+}
+
+// Reads a line of input on the status line; false on Escape
+static bool prompt(const char *label, char *buf, size_t size, bool digits) {
+  size_t pos = 0;
+  buf[0] = '\0';
+  curs_set(1);
+  for (;;) {
+    mvprintw(LINES - 1, 0, "%s%s", label, buf);
+    clrtoeol();
+    refresh();
+    int c = getch();
+    if (c == '\n' || c == KEY_ENTER)
+      break;
+    if (c == 27) {
+      pos = 0;
+      buf[0] = '\0';
+      break;
+    }
+    if ((c == KEY_BACKSPACE || c == 127) && pos > 0)
+      buf[--pos] = '\0';
+    else if (c >= ' ' && c < 127 && pos + 1 < size &&
+             (!digits || (c >= '0' && c <= '9'))) {
+      buf[pos++] = (char)c;
+      buf[pos] = '\0';
+    }
+  }
+  curs_set(0);
+  return pos > 0;
+}
+
+// One line as it fits the screen: tabs expanded, control bytes shown as ?
+static void draw_line(int row, const char *s, size_t len) {
+  char buf[4096];
+  size_t n = 0;
+  int col = 0;
+  for (size_t i = 0; i < len && n + 8 < sizeof(buf); i++) {
+    unsigned char c = (unsigned char)s[i];
+    // A character is finished even at the edge, so no sequence is cut
+    if (col >= COLS && (c & 0xc0) != 0x80)
+      break;
+    if (c == '\t') {
+      do
+        buf[n++] = ' ';
+      while (++col % 8 && col < COLS);
+    } else if (c < ' ' || c == 127) {
+      if (c == '\r' && i + 1 == len)
+        break;
+      buf[n++] = '?';
+      col++;
+    } else {
+      buf[n++] = (char)c;
+      // UTF-8 continuation bytes take no column of their own
+      col += (c & 0xc0) != 0x80;
+    }
+  }
+  mvaddnstr(row, 0, buf, (int)n);
+  clrtoeol();
+}
+
+static void draw(viewer *v) {
+  size_t off = v->top;
+  erase();
+  for (int row = 0; row < rows() && off < v->size; row++) {
+    size_t next = next_line(v, off);
+    size_t len = next - off;
+    if (len && v->data[next - 1] == '\n')
+      len--;
+    draw_line(row, v->data + off, len);
+    off = next;
+  }
+  attron(A_REVERSE);
+  if (v->message)
+    mvprintw(LINES - 1, 0, "%s", v->message);
+  else if (!v->size)
+    mvprintw(LINES - 1, 0, "%s  empty", v->name);
+  else if (v->top <= v->indexed && v->indexed == v->size)
+    mvprintw(LINES - 1, 0, "%s  line %zu of %zu", v->name,
+             line_of(v, v->top) + 1, v->indexed_lines + (v->size &&
+             v->data[v->size - 1] != '\n'));
+  else if (v->top <= v->indexed)
+    mvprintw(LINES - 1, 0, "%s  line %zu  %d%%", v->name,
+             line_of(v, v->top) + 1, (int)(off * 100 / v->size));
+  else
+    mvprintw(LINES - 1, 0, "%s  %d%%", v->name,
+             (int)(off * 100 / v->size));
+  attroff(A_REVERSE);
+  refresh();
+  v->message = NULL;
+}
+
+int view_file(const char *path) {
+  viewer v = {0};
+  struct stat st;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return -1;
+  }
+  v.size = (size_t)st.st_size;
+  v.data = v.size ? mmap(NULL, v.size, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+  close(fd);
+  if (v.data == MAP_FAILED ||
+      !(v.marks = malloc((v.cap_marks = 1024) * sizeof(*v.marks)))) {
+    if (v.data != MAP_FAILED && v.size)
+      munmap((void *)v.data, v.size);
+    return -1;
+  }
+  v.marks[v.n_marks++] = (line_mark){0, 0};
+  const char *slash = strrchr(path, '/');
+  v.name = slash ? slash + 1 : path;
+  keypad(stdscr, TRUE);
+  curs_set(0);
+  for (bool done = false; !done;) {
+    // Scrolling keeps the index just behind the screen, as long as that is
+    // one step away; a jump past it leaves the lines unnumbered
+    if (v.top > v.indexed && v.top - v.indexed <= STEP)
+      index_to(&v, v.top);
+    draw(&v);
+    char input[MAX_QUERY];
+    size_t to, line;
+    int c = getch();
+    switch (c) {
+    case 'q':
+    case 27:
+      done = true;
+      break;
+    case KEY_DOWN:
+    case 'j':
+      if (v.top < last_top(&v))
+        v.top = next_line(&v, v.top);
+      break;
+    case KEY_UP:
+    case 'k':
+      v.top = prev_line(&v, v.top);
+      break;
+    case KEY_NPAGE:
+    case ' ':
+    case 'f':
+      to = last_top(&v);
+      for (int i = 0; i < rows() - 1 && v.top < to; i++)
+        v.top = next_line(&v, v.top);
+      break;
+    case KEY_PPAGE:
+    case 'b':
+      for (int i = 0; i < rows() - 1 && v.top; i++)
+        v.top = prev_line(&v, v.top);
+      break;
+    case KEY_HOME:
+    case 'g':
+      v.top = 0;
+      break;
+    case KEY_END:
+    case 'G':
+      v.top = last_top(&v);
+      break;
+    case ':':
+      if (!prompt(":", input, 20, true))
+        break;
+      line = strtoull(input, NULL, 10);
+      if ((to = find_line(&v, line ? line - 1 : 0)) != SIZE_MAX)
+        v.top = to < last_top(&v) ? to : last_top(&v);
+      break;
+    case '/':
+      if (!prompt("/", input, sizeof(input), false))
+        break;
+      memcpy(v.query, input, sizeof(v.query));
+      // fall through
+    case 'n':
+      if (!v.query[0])
+        v.message = "No previous search";
+      else if ((to = search(&v)) != SIZE_MAX)
+        v.top = to;
+      break;
+    default:
+      break;
+    }
+  }
+  if (v.size)
+    munmap((void *)v.data, v.size);
+  free(v.marks);
+  return 0;
+}
+
+#else
+
+#include "view.h"
+
+// The viewer maps files with POSIX calls; Windows keeps no viewer
+int view_file(const char *path) {
+  (void)path;
+  return -1;
+}
+
+#endif
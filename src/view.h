@@ -0,0 +1,29 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VIEW_H
+#define VIEW_H
+
+// A read-only viewer for files of any size, on key v. The file is mapped
+// rather than read and the screen is placed by byte offset, so opening and
+// scrolling cost the same for a 20 GB log as for a short note. Lines are
+// numbered through a sparse index of about every 1024th line start, built
+// only as far as scrolling or going to a line has needed.
+int view_file(const char *);
+
+#endif
@@ -0,0 +1,694 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+// Parallel directory walker. Every thread owns a deque of directories still
+// to be read: it pushes and pops subdirectories at the tail, depth first,
+// and when it runs dry it steals from the head of another thread's deque.
+// Paths found are published in batches and handed to the UI by walk_take
+// while the walk is still running. With an index file, directories whose
+// mtime has not moved since the last walk are listed from the mapped index
+// instead of being read again.
+
+#include "walk.h"
+#include "treeindex.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WALK_BATCH 256
+#define IGNORE_FILE_MAX (256 * 1024)
+
+typedef struct ignore_rule {
+  char *pattern;
+  bool negate, dir_only, anchored;
+} ignore_rule;
+
+// Rules of one ignore file, chained to the files of the parent directories.
+// base is the directory holding the file, relative to the walk root.
+typedef struct ignore_set {
+  struct ignore_set *parent, *next_alloc;
+  char *base;
+  ignore_rule *rules;
+  int n_rules;
+} ignore_set;
+
+typedef struct walk_job {
+  char *path;
+  int depth;
+  ignore_set *ignore;
+} walk_job;
+
+typedef struct walk_deque {
+  pthread_mutex_t lock;
+  walk_job *jobs;
+  int head, tail, cap;
+} walk_deque;
+
+typedef struct dir_id {
+  dev_t dev;
+  ino_t ino;
+} dir_id;
+
+typedef struct worker_arg {
+  walker *w;
+  int self;
+  // Raw listing of the directory being read, kept for the index
+  tree_index_entry *ents;
+  char *names;
+  uint32_t n_ents, cap_ents;
+  size_t names_size, cap_names;
+} worker_arg;
+
+struct walker {
+  walk_options opts;
+  char *root;
+  tree_index *prior;
+  int root_fd, n_threads, n_started;
+  pthread_t *threads;
+  worker_arg *args;
+  walk_deque *deques;
+  // Jobs queued or being processed; the walk is over when it drops to zero
+  long pending;
+  int stop, idle, indexing;
+
+  // Everything below is guarded by lock
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool finished;
+  char **results;
+  int n_results, cap_results;
+  dir_id *visited;
+  size_t n_visited, cap_visited;
+  ignore_set *ignores;
+  tree_index_builder index;
+};
+
+static char *join_path(const char *dir, const char *name) {
+  size_t dl = strlen(dir), nl = strlen(name);
+  char *p = malloc(dl + nl + 2);
+  if (!p)
+    return NULL;
+  if (dl) {
+    memcpy(p, dir, dl);
+    p[dl++] = '/';
+  }
+  memcpy(p + dl, name, nl + 1);
+  return p;
+}
+
+static size_t hash_id(dir_id id, size_t cap) {
+  unsigned long long h = (unsigned long long)id.ino * 0x9e3779b97f4a7c15ULL;
+  h ^= (unsigned long long)id.dev + (h >> 29);
+  return (size_t)h & (cap - 1);
+}
+
+// Records a directory and reports whether it had been seen before, which is
+// how symlink and bind-mount cycles are cut. Called with w->lock held.
+static bool visit_once(walker *w, dir_id id) {
+  if ((w->n_visited + 1) * 2 > w->cap_visited) {
+    size_t cap = w->cap_visited ? w->cap_visited * 2 : 1024;
+    dir_id *table = calloc(cap, sizeof(*table));
+    if (!table)
+      return true;
+    for (size_t i = 0; i < w->cap_visited; i++) {
+      dir_id old = w->visited[i];
+      if (!old.ino)
+        continue;
+      size_t h = hash_id(old, cap);
+      while (table[h].ino)
+        h = (h + 1) & (cap - 1);
+      table[h] = old;
+    }
+    free(w->visited);
+    w->visited = table;
+    w->cap_visited = cap;
+  }
+  size_t h = hash_id(id, w->cap_visited);
+  while (w->visited[h].ino) {
+    if (w->visited[h].ino == id.ino && w->visited[h].dev == id.dev)
+      return false;
+    h = (h + 1) & (w->cap_visited - 1);
+  }
+  w->visited[h] = id;
+  w->n_visited++;
+  return true;
+}
+
+// Parses one .gitignore-style file. Returns parent unchanged when the file
+// does not exist or holds no rules.
+static ignore_set *load_ignore(walker *w, int dirfd, const char *file,
+                               const char *base, ignore_set *parent) {
+  int fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return parent;
+  char *buf = malloc(IGNORE_FILE_MAX + 1);
+  ssize_t len = buf ? read(fd, buf, IGNORE_FILE_MAX) : -1;
+  close(fd);
+  if (len <= 0) {
+    free(buf);
+    return parent;
+  }
+  buf[len] = '\0';
+
+  ignore_set *set = calloc(1, sizeof(*set));
+  int cap = 0;
+  if (!set || !(set->base = strdup(base))) {
+    free(set);
+    free(buf);
+    return parent;
+  }
+  char *save;
+  for (char *line = strtok_r(buf, "\n", &save); line;
+       line = strtok_r(NULL, "\n", &save)) {
+    size_t n = strlen(line);
+    while (n && (line[n - 1] == '\r' || line[n - 1] == ' '))
+      line[--n] = '\0';
+    if (!n || line[0] == '#')
+      continue;
+    ignore_rule rule = {0};
+    if (line[0] == '!') {
+      rule.negate = true;
+      line++;
+      n--;
+    } else if (line[0] == '\\')
+      line++, n--;
+    if (n && line[n - 1] == '/') {
+      rule.dir_only = true;
+      line[--n] = '\0';
+    }
+    if (line[0] == '/') {
+      rule.anchored = true;
+      line++;
+    } else if (strchr(line, '/'))
+      rule.anchored = true;
+    if (!*line)
+      continue;
+    if (set->n_rules == cap) {
+      cap = cap ? cap * 2 : 16;
+      ignore_rule *tmp = realloc(set->rules, cap * sizeof(*tmp));
+      if (!tmp)
+        break;
+      set->rules = tmp;
+    }
+    if (!(rule.pattern = strdup(line)))
+      break;
+    set->rules[set->n_rules++] = rule;
+  }
+  free(buf);
+  set->parent = parent;
+  pthread_mutex_lock(&w->lock);
+  set->next_alloc = w->ignores;
+  w->ignores = set;
+  pthread_mutex_unlock(&w->lock);
+  return set;
+}
+
+// The deepest file with a matching rule decides, and within a file the last
+// matching rule wins, as in git.
+static bool is_ignored(const ignore_set *set, const char *path,
+                       const char *name, bool is_dir) {
+  for (; set; set = set->parent) {
+    size_t bl = strlen(set->base);
+    const char *rel = bl ? path + bl + 1 : path;
+    for (int i = set->n_rules - 1; i >= 0; i--) {
+      const ignore_rule *r = &set->rules[i];
+      if (r->dir_only && !is_dir)
+        continue;
+      int flags = strstr(r->pattern, "**") ? 0 : FNM_PATHNAME;
+      if (fnmatch(r->pattern, r->anchored ? rel : name,
+                  r->anchored ? flags : 0) == 0)
+        return !r->negate;
+    }
+  }
+  return false;
+}
+
+static bool push_job(walker *w, int self, walk_job job) {
+  walk_deque *d = &w->deques[self];
+  pthread_mutex_lock(&d->lock);
+  if (d->tail == d->cap) {
+    // Compact before growing so a long-lived deque does not creep forward
+    int live = d->tail - d->head;
+    if (d->head > 0 && live < d->cap / 2) {
+      memmove(d->jobs, d->jobs + d->head, live * sizeof(*d->jobs));
+    } else {
+      int cap = d->cap ? d->cap * 2 : 64;
+      walk_job *tmp = realloc(d->jobs, cap * sizeof(*tmp));
+      if (!tmp) {
+        pthread_mutex_unlock(&d->lock);
+        return false;
+      }
+      memmove(tmp, tmp + d->head, live * sizeof(*tmp));
+      d->jobs = tmp;
+      d->cap = cap;
+    }
+    d->head = 0;
+    d->tail = live;
+  }
+  __atomic_add_fetch(&w->pending, 1, __ATOMIC_SEQ_CST);
+  d->jobs[d->tail++] = job;
+  pthread_mutex_unlock(&d->lock);
+  if (__atomic_load_n(&w->idle, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&w->lock);
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+  }
+  return true;
+}
+
+static bool take_job(walker *w, int self, walk_job *job) {
+  walk_deque *d = &w->deques[self];
+  pthread_mutex_lock(&d->lock);
+  if (d->tail > d->head) {
+    *job = d->jobs[--d->tail];
+    pthread_mutex_unlock(&d->lock);
+    return true;
+  }
+  pthread_mutex_unlock(&d->lock);
+  for (int i = 1; i < w->n_threads; i++) {
+    walk_deque *victim = &w->deques[(self + i) % w->n_threads];
+    pthread_mutex_lock(&victim->lock);
+    if (victim->tail > victim->head) {
+      *job = victim->jobs[victim->head++];
+      pthread_mutex_unlock(&victim->lock);
+      return true;
+    }
+    pthread_mutex_unlock(&victim->lock);
+  }
+  return false;
+}
+
+static void publish(walker *w, char **batch, int n) {
+  if (!n)
+    return;
+  pthread_mutex_lock(&w->lock);
+  if (w->n_results + n > w->cap_results) {
+    int cap = w->cap_results ? w->cap_results * 2 : 4096;
+    while (cap < w->n_results + n)
+      cap *= 2;
+    char **tmp = realloc(w->results, cap * sizeof(*tmp));
+    if (!tmp) {
+      pthread_mutex_unlock(&w->lock);
+      for (int i = 0; i < n; i++)
+        free(batch[i]);
+      return;
+    }
+    w->results = tmp;
+    w->cap_results = cap;
+  }
+  memcpy(w->results + w->n_results, batch, n * sizeof(*batch));
+  w->n_results += n;
+  pthread_mutex_unlock(&w->lock);
+}
+
+static unsigned entry_kind(int dirfd, const struct dirent *e) {
+  switch (e->d_type) {
+  case DT_DIR:
+    return TREE_DIR;
+  case DT_REG:
+    return TREE_FILE;
+  case DT_LNK:
+    return TREE_LINK;
+  case DT_UNKNOWN:
+    break;
+  default:
+    return TREE_OTHER;
+  }
+  struct stat st;
+  if (fstatat(dirfd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    return TREE_OTHER;
+  return S_ISDIR(st.st_mode)   ? TREE_DIR
+         : S_ISLNK(st.st_mode) ? TREE_LINK
+         : S_ISREG(st.st_mode) ? TREE_FILE
+                               : TREE_OTHER;
+}
+
+static bool keep_entry(worker_arg *arg, const struct dirent *e,
+                       unsigned kind) {
+  size_t len = strlen(e->d_name) + 1;
+  if (arg->n_ents == arg->cap_ents) {
+    uint32_t cap = arg->cap_ents ? arg->cap_ents * 2 : 256;
+    tree_index_entry *tmp = realloc(arg->ents, cap * sizeof(*tmp));
+    if (!tmp)
+      return false;
+    arg->ents = tmp;
+    arg->cap_ents = cap;
+  }
+  if (arg->names_size + len > arg->cap_names) {
+    size_t cap = arg->cap_names ? arg->cap_names * 2 : 16384;
+    while (cap < arg->names_size + len)
+      cap *= 2;
+    char *tmp = realloc(arg->names, cap);
+    if (!tmp)
+      return false;
+    arg->names = tmp;
+    arg->cap_names = cap;
+  }
+  memcpy(arg->names + arg->names_size, e->d_name, len);
+  arg->ents[arg->n_ents++] =
+      (tree_index_entry){e->d_ino, arg->names_size, kind, 0};
+  arg->names_size += len;
+  return true;
+}
+
+static void record_dir(walker *w, const char *path, const struct stat *st,
+                       const tree_index_entry *ents, uint32_t n,
+                       const char *names) {
+  pthread_mutex_lock(&w->lock);
+  if (__atomic_load_n(&w->indexing, __ATOMIC_RELAXED) &&
+      !tree_index_add_dir(&w->index, path, st, ents, n, names))
+    __atomic_store_n(&w->indexing, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&w->lock);
+}
+
+// Filters one entry of the directory being read, queueing it for descent
+// and adding it to the batch of results.
+static void visit_entry(walker *w, int self, const walk_job *job, int dirfd,
+                        const ignore_set *ignore, const char *name,
+                        unsigned kind, char **batch, int *n) {
+  if (name[0] == '.' &&
+      (!name[1] || (name[1] == '.' && !name[2]) || !w->opts.show_hidden ||
+       strcmp(name, ".git") == 0))
+    return;
+  bool is_dir = kind == TREE_DIR;
+  if (kind == TREE_LINK && w->opts.follow_symlinks) {
+    struct stat st;
+    is_dir = fstatat(dirfd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+  }
+  char *path = join_path(job->path, name);
+  if (!path)
+    return;
+  if (ignore && is_ignored(ignore, path, name, is_dir)) {
+    free(path);
+    return;
+  }
+  if (is_dir &&
+      (w->opts.max_depth < 0 || job->depth + 1 <= w->opts.max_depth)) {
+    char *sub = strdup(path);
+    if (sub && !push_job(w, self, (walk_job){sub, job->depth + 1, job->ignore}))
+      free(sub);
+  }
+  batch[(*n)++] = path;
+  if (*n == WALK_BATCH) {
+    publish(w, batch, *n);
+    *n = 0;
+  }
+}
+
+static void read_dir(walker *w, worker_arg *arg, walk_job *job) {
+  int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  if (!w->opts.follow_symlinks)
+    flags |= O_NOFOLLOW;
+  int fd = openat(w->root_fd, *job->path ? job->path : ".", flags);
+  if (fd < 0)
+    return;
+  struct stat st;
+  bool fresh = false;
+  if (fstat(fd, &st) == 0) {
+    pthread_mutex_lock(&w->lock);
+    fresh = visit_once(w, (dir_id){st.st_dev, st.st_ino});
+    pthread_mutex_unlock(&w->lock);
+  }
+  if (!fresh) {
+    close(fd);
+    return;
+  }
+  ignore_set *ignore = job->ignore;
+  if (w->opts.use_ignore_files) {
+    ignore = load_ignore(w, fd, ".gitignore", job->path, ignore);
+    ignore = load_ignore(w, fd, ".ignore", job->path, ignore);
+  }
+  walk_job sub = {job->path, job->depth, ignore};
+  bool indexing = __atomic_load_n(&w->indexing, __ATOMIC_RELAXED);
+
+  char *batch[WALK_BATCH];
+  int n = 0;
+  const tree_index_dir *cached =
+      w->prior ? tree_index_lookup(w->prior, job->path, &st) : NULL;
+  if (cached) {
+    const tree_index_entry *ents = tree_index_entries(w->prior, cached);
+    const char *names = tree_index_strings(w->prior);
+    for (uint32_t i = 0;
+         i < cached->n_entries && !__atomic_load_n(&w->stop, __ATOMIC_RELAXED);
+         i++)
+      visit_entry(w, arg->self, &sub, fd, ignore, names + ents[i].name_off,
+                  ents[i].kind, batch, &n);
+    if (indexing)
+      record_dir(w, job->path, &st, ents, cached->n_entries, names);
+    close(fd);
+    publish(w, batch, n);
+    return;
+  }
+
+  DIR *dir = fdopendir(fd);
+  if (!dir) {
+    close(fd);
+    return;
+  }
+  arg->n_ents = 0;
+  arg->names_size = 0;
+  struct dirent *e;
+  while ((e = readdir(dir)) != NULL &&
+         !__atomic_load_n(&w->stop, __ATOMIC_RELAXED)) {
+    const char *name = e->d_name;
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+      continue;
+    unsigned kind = entry_kind(fd, e);
+    if (indexing && !keep_entry(arg, e, kind)) {
+      indexing = false;
+      __atomic_store_n(&w->indexing, 0, __ATOMIC_RELAXED);
+    }
+    visit_entry(w, arg->self, &sub, fd, ignore, name, kind, batch, &n);
+  }
+  // A listing cut short by walk_stop is never written out
+  if (indexing && !e)
+    record_dir(w, job->path, &st, arg->ents, arg->n_ents, arg->names);
+  publish(w, batch, n);
+  closedir(dir);
+}
+
+static void *worker_main(void *p) {
+  worker_arg *arg = p;
+  walker *w = arg->w;
+  while (!__atomic_load_n(&w->stop, __ATOMIC_RELAXED)) {
+    walk_job job;
+    if (take_job(w, arg->self, &job)) {
+      read_dir(w, arg, &job);
+      free(job.path);
+      if (__atomic_sub_fetch(&w->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&w->lock);
+        w->finished = true;
+        pthread_cond_broadcast(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+        // Only a walk that ran to the end describes the whole tree
+        if (__atomic_load_n(&w->indexing, __ATOMIC_SEQ_CST) &&
+            !__atomic_load_n(&w->stop, __ATOMIC_SEQ_CST))
+          tree_index_write(&w->index, w->root, w->opts.index_file);
+      }
+      continue;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->finished) {
+      pthread_mutex_unlock(&w->lock);
+      break;
+    }
+    // Nothing to steal right now, but other threads are still reading
+    // directories that may yield more work
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += 2000000;
+    if (until.tv_nsec >= 1000000000) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000;
+    }
+    __atomic_add_fetch(&w->idle, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_timedwait(&w->wake, &w->lock, &until);
+    __atomic_sub_fetch(&w->idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&w->lock);
+  }
+  return NULL;
+}
+
+walker *walk_start(const char *root, const walk_options *opts) {
+  walker *w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+  w->opts = *opts;
+  w->n_threads = opts->n_threads;
+  if (w->n_threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    w->n_threads = cpus > 0 ? (int)cpus : 1;
+  }
+  w->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (opts->index_file && (w->root = strdup(root))) {
+    w->prior = tree_index_open(opts->index_file, root);
+    w->indexing = 1;
+  }
+  w->threads = calloc(w->n_threads, sizeof(*w->threads));
+  w->args = calloc(w->n_threads, sizeof(*w->args));
+  w->deques = calloc(w->n_threads, sizeof(*w->deques));
+  char *start = strdup("");
+  if (w->root_fd < 0 || !w->threads || !w->args || !w->deques || !start) {
+    if (w->root_fd >= 0)
+      close(w->root_fd);
+    tree_index_close(w->prior);
+    free(w->root);
+    free(w->threads);
+    free(w->args);
+    free(w->deques);
+    free(start);
+    free(w);
+    return NULL;
+  }
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->wake, NULL);
+  for (int i = 0; i < w->n_threads; i++)
+    pthread_mutex_init(&w->deques[i].lock, NULL);
+  push_job(w, 0, (walk_job){start, 0, NULL});
+  int started = 0;
+  for (; started < w->n_threads; started++) {
+    w->args[started].w = w;
+    w->args[started].self = started;
+    if (pthread_create(&w->threads[started], NULL, worker_main,
+                       &w->args[started]) != 0)
+      break;
+  }
+  // Threads that failed to start leave their deque to be stolen from; with
+  // none at all, walk synchronously
+  w->n_started = started;
+  if (!started)
+    worker_main(&w->args[0]);
+  return w;
+}
+
+// Moves the paths found since the last call to the end of the caller's
+// growable array. Returns the number of paths added.
+int walk_take(walker *w, char ***paths, int *n, int *cap) {
+  pthread_mutex_lock(&w->lock);
+  int got = w->n_results;
+  if (!got) {
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+  }
+  if (*n + got > *cap) {
+    int new_cap = *cap ? *cap : 4096;
+    while (new_cap < *n + got)
+      new_cap *= 2;
+    char **tmp = realloc(*paths, new_cap * sizeof(*tmp));
+    if (!tmp) {
+      pthread_mutex_unlock(&w->lock);
+      return 0;
+    }
+    *paths = tmp;
+    *cap = new_cap;
+  }
+  memcpy(*paths + *n, w->results, got * sizeof(*w->results));
+  *n += got;
+  w->n_results = 0;
+  pthread_mutex_unlock(&w->lock);
+  return got;
+}
+
+bool walk_finished(walker *w) {
+  pthread_mutex_lock(&w->lock);
+  bool finished = w->finished && w->n_results == 0;
+  pthread_mutex_unlock(&w->lock);
+  return finished;
+}
+
+void walk_stop(walker *w) {
+  if (!w)
+    return;
+  __atomic_store_n(&w->stop, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&w->lock);
+  pthread_cond_broadcast(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+  for (int i = 0; i < w->n_started; i++)
+    pthread_join(w->threads[i], NULL);
+  for (int i = 0; i < w->n_threads; i++) {
+    walk_deque *d = &w->deques[i];
+    for (int j = d->head; j < d->tail; j++)
+      free(d->jobs[j].path);
+    free(d->jobs);
+    pthread_mutex_destroy(&d->lock);
+  }
+  for (int i = 0; i < w->n_results; i++)
+    free(w->results[i]);
+  while (w->ignores) {
+    ignore_set *next = w->ignores->next_alloc;
+    for (int i = 0; i < w->ignores->n_rules; i++)
+      free(w->ignores->rules[i].pattern);
+    free(w->ignores->rules);
+    free(w->ignores->base);
+    free(w->ignores);
+    w->ignores = next;
+  }
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->wake);
+  free(w->results);
+  free(w->visited);
+  free(w->deques);
+  free(w->threads);
+  for (int i = 0; i < w->n_threads; i++) {
+    free(w->args[i].ents);
+    free(w->args[i].names);
+  }
+  free(w->args);
+  tree_index_builder_free(&w->index);
+  tree_index_close(w->prior);
+  free(w->root);
+  close(w->root_fd);
+  free(w);
+}
+
+#else
+
+#include "walk.h"
+#include <stddef.h>
+
+// Recursive find is not implemented on Windows: no walk ever starts
+walker *walk_start(const char *root, const walk_options *opts) {
+  (void)root;
+  (void)opts;
+  return NULL;
+}
+
+int walk_take(walker *w, char ***paths, int *n, int *cap) {
+  (void)w;
+  (void)paths;
+  (void)n;
+  (void)cap;
+  return 0;
+}
+
+bool walk_finished(walker *w) {
+  (void)w;
+  return true;
+}
+
+void walk_stop(walker *w) { (void)w; }
+
+#endif
@@ -0,0 +1,42 @@
+// Copyright (c) 2025 Eduardo Meli
+/*
+This file is part of fex.
+
+fex is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+fex is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with fex.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdbool.h>
+
+typedef struct walk_options {
+  int max_depth; // deepest directory level read, the root being 0; negative
+                 // for no limit
+  int n_threads; // 0 picks one per online CPU
+  bool show_hidden;
+  bool use_ignore_files; // honour .gitignore and .ignore
+  bool follow_symlinks;
+  // Index file reused for directories unchanged since the last walk and
+  // rewritten when this one completes; NULL to always read from disk
+  const char *index_file;
+} walk_options;
+
+typedef struct walker walker;
+
+walker *walk_start(const char *, const walk_options *);
+int walk_take(walker *, char ***, int *, int *);
+bool walk_finished(walker *);
+void walk_stop(walker *);
+
+#endif
@@ -3,14 +3,11 @@
 // http://www.boost.org/LICENSE_1_0.txt
 
 #include "xdg.h"
-#include <fcntl.h>
+#include "platform.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/resource.h>
-#include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
 int findExecutable(const char *baseName, char *buf, size_t size) {
@@ -61,56 +58,14 @@ int findExecutable(const char *baseName, char *buf, size_t size) {
   return 0;
 }
 
-void execProcess(const char *executable, char *const args[]) {
-  // close all file descriptors
-  // Possible optimization: use poll and close only valid descriptors.
-  struct rlimit r;
-  if (getrlimit(RLIMIT_NOFILE, &r) != 0) {
-    int maxDescriptors = (int)r.rlim_cur;
-    int i;
-    for (i = 0; i < maxDescriptors; ++i) {
-      close(i);
-    }
-  }
-
-  // set standard streams to /dev/null
-  int devNull = open("/dev/null", O_RDWR);
-  if (devNull > 0) {
-    dup2(devNull, STDIN_FILENO);
-    dup2(devNull, STDOUT_FILENO);
-    dup2(devNull, STDERR_FILENO);
-  }
-  close(devNull);
-
-  // detach from process group of parent
-  setsid();
-
-  execv(executable, args);
-  _exit(1);
-}
-
 int openFile(const char *path) {
   char xdgOpen[256];
-  if (findExecutable("xdg-open", xdgOpen, sizeof(xdgOpen))) {
+  if (platform_find_executable("xdg-open", xdgOpen, sizeof(xdgOpen))) {
     char *argv[] = {xdgOpen, (char *)path, NULL};
-    pid_t pid = fork();
-    if (pid == 0) {
-      pid_t doubleFork = fork();
-      if (doubleFork == 0) {
-        execProcess(xdgOpen, argv);
-      } else if (doubleFork > 0) {
-        _exit(0);
-      } else {
-        _exit(1);
-      }
-    } else if (pid < 0) {
-      perror("Could not fork");
+    // spawned in a session of its own, with no fork of this process
+    if (platform_spawn_detached(argv) != 0) {
+      perror("Could not spawn xdg-open");
       return 1;
-    } else {
-      int status;
-      // wait for the first fork
-      waitpid(pid, &status, 0);
-      return status;
     }
   } else {
     fprintf(stderr, "Could not find xdg-open utility\n");
@@ -19,5 +19,4 @@ along with fex.  If not, see <http://www.gnu.org/licenses/>.
 #include <stddef.h>
 
 int findExecutable(const char *, char *, size_t);
-void execProcess(const char *, char *const[]);
 int openFile(const char *);
@@ -0,0 +1,50 @@
+#!/bin/sh
+
+# Checks that a helper spawned by fex gets stdin, stdout and stderr and no
+# other descriptor: fex runs with fd 7 open and describes an entry through a
+# stub `file` that lists the descriptors it was given.
+
+set -eu
+
+FEX=${1:-./fex_exec}
+case $FEX in
+  /*) ;;
+  *) FEX=$(pwd)/$FEX ;;
+esac
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+TMP=$(cd "$TMP" && pwd -P)
+
+mkdir "$TMP/bin" "$TMP/dir" "$TMP/home"
+: > "$TMP/dir/entry"
+
+cat > "$TMP/bin/file" <<'STUB'
+#!/bin/sh
+exec ls -l /proc/self/fd > "$FEX_TEST_FDS"
+STUB
+chmod +x "$TMP/bin/file"
+
+printf 'j\n' > "$TMP/script"
+
+FEX_TEST_FDS=$TMP/fds PATH=$TMP/bin:$PATH HOME=$TMP/home \
+  XDG_CACHE_HOME=$TMP/home/.cache XDG_CONFIG_HOME=$TMP/home/.config \
+  XDG_DATA_HOME=$TMP/home/.local/share FEX_NO_SERVER=1 \
+  "$FEX" --replay "$TMP/script" "$TMP/dir" > /dev/null 7> "$TMP/held"
+
+if [ ! -s "$TMP/fds" ]; then
+  echo "fd_leak: the stub file was never run" >&2
+  exit 1
+fi
+# Left out: the stub's script, should its shell have kept it open, and the
+# directory ls reads the list from
+fds=$(awk -v self="$TMP/bin/file" '
+  { for (i = 2; i < NF; i++)
+      if ($i == "->" && $(i + 1) != self && $(i + 1) !~ /^\/proc\/[0-9]+\/fd$/)
+        print $(i - 1) }
+' "$TMP/fds" | sort -n | tr '\n' ' ')
+if [ "$fds" != "0 1 2 " ]; then
+  echo "fd_leak: the child got descriptors ${fds}instead of 0 1 2" >&2
+  exit 1
+fi
+echo "fd_leak: ok"